@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Stand-in rtl_tcp server replaying a cu8 recording in a loop, paced at the
+# sample rate requested by the client.
+#
+#   scripts/rtl_tcp_replay.py capture.cu8 [port]
+import socket
+import struct
+import sys
+import threading
+import time
+
+COMMANDS = {1: "frequency", 2: "sample rate", 3: "gain mode", 4: "gain", 8: "agc mode"}
+
+
+def read_commands(conn, state):
+    buf = b""
+    while True:
+        data = conn.recv(64)
+        if not data:
+            return
+        buf += data
+        while len(buf) >= 5:
+            cmd, param = struct.unpack(">BI", buf[:5])
+            buf = buf[5:]
+            print(f"{COMMANDS.get(cmd, hex(cmd))}: {param}")
+            if cmd == 2 and param > 0:
+                state["rate"] = param
+
+
+def serve(conn, path):
+    state = {"rate": 256000}
+    threading.Thread(target=read_commands, args=(conn, state), daemon=True).start()
+    # R820T with its 29 gain steps
+    conn.sendall(b"RTL0" + struct.pack(">II", 5, 29))
+    chunk = 16384
+    with open(path, "rb") as f:
+        start = time.monotonic()
+        sent = 0
+        while True:
+            data = f.read(chunk)
+            if len(data) < chunk:
+                f.seek(0)
+                data += f.read(chunk - len(data))
+            conn.sendall(data)
+            sent += len(data) // 2
+            delay = start + sent / state["rate"] - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(f"usage: {sys.argv[0]} file.cu8 [port]")
+    port = int(sys.argv[2]) if len(sys.argv) > 2 else 1234
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("127.0.0.1", port))
+    srv.listen(1)
+    print(f"Replaying {sys.argv[1]} on 127.0.0.1:{port}")
+    while True:
+        conn, addr = srv.accept()
+        print(f"Client {addr[0]}:{addr[1]} connected")
+        try:
+            serve(conn, sys.argv[1])
+        except (BrokenPipeError, ConnectionResetError):
+            print("Client disconnected")
+        finally:
+            conn.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "AMDemodulator.hpp"
+#include <algorithm>
+#include <cmath>
+
+AMDemodulator::AMDemodulator(void) noexcept :
+    decimation_{1},
+    audio_rate_{0},
+    taps_length_{0},
+    taps_{},
+    history_{},
+    head_{0},
+    phase_{0},
+    carrier_{0.f},
+    carrier_alpha_{0.f},
+    peak_{0.f},
+    release_{0.f},
+    target_{0.3f},
+    max_gain_{1000.f}
+{
+}
+
+void AMDemodulator::configure(unsigned int sample_rate, unsigned int audio_rate, float bandwidth, unsigned int taps)
+{
+    decimation_ = std::max(1U, sample_rate / audio_rate);
+    audio_rate_ = sample_rate / decimation_;
+    taps_length_ = std::max(1U, taps);
+
+    // Blackman-windowed sinc, cut off at half the channel bandwidth, unity gain at DC
+    float const pi = 3.14159265358979f;
+    float const fc = bandwidth / 2.f / sample_rate;
+    float const mid = (taps_length_ - 1) / 2.f;
+    std::vector<float> h(taps_length_);
+    float sum = 0.f;
+
+    for (unsigned int n = 0; n < taps_length_; ++n) {
+        float const x = n - mid;
+        float const sinc = x == 0.f ? 2.f * fc : std::sin(2.f * pi * fc * x) / (pi * x);
+        float const w = taps_length_ > 1 ? 0.42f - 0.5f * std::cos(2.f * pi * n / (taps_length_ - 1)) + 0.08f * std::cos(4.f * pi * n / (taps_length_ - 1)) : 1.f;
+        h[n] = sinc * w;
+        sum += h[n];
+    }
+
+    // Each tap appears twice so it lines up with interleaved I/Q
+    taps_.resize(taps_length_ * 2);
+    for (unsigned int n = 0; n < taps_length_; ++n) {
+        taps_[n*2] = h[n] / sum;
+        taps_[n*2+1] = h[n] / sum;
+    }
+
+    // The history is stored twice back to back, so the filter window is always contiguous
+    history_.assign(taps_length_ * 4, 0.f);
+    head_ = 0;
+    phase_ = 0;
+
+    // About 50 ms for the carrier tracker, well below the voice band
+    carrier_alpha_ = 1.f - std::exp(-1.f / (0.05f * audio_rate_));
+    carrier_ = 0.f;
+    // The AGC peak decays by 20 dB in about two seconds
+    release_ = std::exp(std::log(0.1f) / (2.f * audio_rate_));
+    peak_ = 0.f;
+}
+
+void AMDemodulator::execute(std::vector<float> const& in, std::vector<std::int16_t>& out) noexcept
+{
+    unsigned int const in_size = in.size() & ~1U;
+    unsigned int const length = taps_length_;
+    float const* taps = taps_.data();
+    float* hist = history_.data();
+
+    // Keeps the capacity from previous buffers
+    out.clear();
+
+    for (unsigned int n = 0; n < in_size; n += 2) {
+        hist[head_*2] = in[n];
+        hist[head_*2+1] = in[n+1];
+        hist[(head_+length)*2] = in[n];
+        hist[(head_+length)*2+1] = in[n+1];
+
+        if (++head_ == length) {
+            head_ = 0;
+        }
+
+        if (++phase_ < decimation_) {
+            continue;
+        }
+
+        phase_ = 0;
+
+        // head_ is now the oldest sample, so the window runs from there for taps_length_ samples
+        float const* window = hist + head_ * 2;
+        float acc[4] = {0.f, 0.f, 0.f, 0.f};
+        unsigned int k = 0;
+
+        // Two complex taps per step give independent accumulators to the pipeline
+        for (; k + 4 <= length * 2; k += 4) {
+            acc[0] += taps[k] * window[k];
+            acc[1] += taps[k+1] * window[k+1];
+            acc[2] += taps[k+2] * window[k+2];
+            acc[3] += taps[k+3] * window[k+3];
+        }
+
+        for (; k < length * 2; k += 2) {
+            acc[0] += taps[k] * window[k];
+            acc[1] += taps[k+1] * window[k+1];
+        }
+
+        float const i = acc[0] + acc[2];
+        float const q = acc[1] + acc[3];
+        float const envelope = std::sqrt(i*i + q*q);
+
+        carrier_ += carrier_alpha_ * (envelope - carrier_);
+        float const audio = envelope - carrier_;
+
+        peak_ = std::max(std::fabs(audio), peak_ * release_);
+        float const gain = std::min(target_ / std::max(peak_, 1e-9f), max_gain_);
+        float const sample = std::min(std::max(audio * gain, -1.f), 1.f);
+
+        out.push_back(static_cast<std::int16_t>(sample * 32767.f));
+    }
+}
+
+unsigned int AMDemodulator::audioRate(void) const noexcept
+{
+    return audio_rate_;
+}
+
+unsigned int AMDemodulator::decimation(void) const noexcept
+{
+    return decimation_;
+}
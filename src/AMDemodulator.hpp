@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_AMDEMODULATOR_HPP
+#define JDRADIO_AMDEMODULATOR_HPP
+
+#include <vector>
+#include <cstdint>
+
+//! AM envelope demodulator for the channel at the center of the capture.
+//!
+//! One pass over the converted IQ samples does the channel filter, the
+//! decimation, the envelope detection and the audio AGC. The low-pass FIR is
+//! only evaluated at the output instants, so its cost is taps * 2 per audio
+//! sample rather than per input sample. The carrier is removed from the
+//! envelope by a slow DC tracker, then the AGC scales the audio towards a
+//! target level with fast attack and slow release.
+class AMDemodulator
+{
+public:
+    AMDemodulator(void) noexcept;
+
+    void configure(unsigned int sample_rate, unsigned int audio_rate, float bandwidth, unsigned int taps);
+    void execute(std::vector<float> const& in, std::vector<std::int16_t>& out) noexcept;
+    unsigned int audioRate(void) const noexcept;
+    unsigned int decimation(void) const noexcept;
+
+private:
+    unsigned int decimation_;
+    unsigned int audio_rate_;
+    unsigned int taps_length_;
+    std::vector<float> taps_;
+    std::vector<float> history_;
+    unsigned int head_;
+    unsigned int phase_;
+    float carrier_;
+    float carrier_alpha_;
+    float peak_;
+    float release_;
+    float target_;
+    float max_gain_;
+};
+
+#endif
@@ -8,10 +8,21 @@
 #include <iostream>
 #include <sstream>
 #include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <cmath>
 #include <fmt/format.h>
-#include <thread>
 #include <chrono>
 #include <wiringPi.h>
+#include <cstdlib>
+#include <cstdio>
+#include <csignal>
+
+//! Default transfer size of rtlsdr_read_async (16 * 32 * 512 bytes), also used for rtl_tcp reads
+static constexpr unsigned int DEFAULT_BUFFER_LENGTH = 16 * 32 * 512;
+
+//! Buffers processed before allocations are treated as a failure
+static constexpr unsigned int ALLOCATION_WARMUP_BUFFERS = 16;
 
 ARCAL::ARCAL(void) noexcept :
     dev_{},
@@ -19,17 +30,90 @@ ARCAL::ARCAL(void) noexcept :
     waterfall_{},
     dc_offset_{std::make_pair(false, 0)},
     filter_dc_{false},
+    noise_blanker_{},
+    blank_noise_{true},
     frequency_{118'025'000U},
     sample_rate_{256'000U},
     agc_enabled_{false},
     rf_gain_{0.f},
-    signal_present_{false},
+    detector_{},
+    journal_{},
+    journal_enabled_{true},
+    journal_path_{"arcal-events.journal"},
     clicks_{},
+    clicks_mutex_{},
     fft_{},
     show_waterfall_{true},
-    task_{}
+    recorder_{},
+    record_iq_{false},
+    spectrum_server_{},
+    stream_spectrum_{false},
+    spectrum_logger_{},
+    log_spectrum_{false},
+    scanner_{},
+    scan_enabled_{false},
+    gain_calibrator_{},
+    auto_gain_{false},
+    recalibrate_gain_{false},
+    calibrating_{false},
+    am_demod_{},
+    audio_sink_{},
+    demod_audio_{false},
+    audio_output_{AudioSink::Output::Fifo},
+    audio_{},
+    samples_{},
+    fft_bins_{},
+    buffer_time_{},
+    buffer_frame_{0},
+    buffer_count_{0},
+    gate_{},
+    gate_enabled_{false},
+    gated_buffers_{0},
+    activations_{0},
+    realtime_profile_{},
+    realtime_{false},
+    jitter_{},
+    measure_jitter_{false},
+    loop_{},
+    click_timer_{-1},
+    gpio_timer_{-1},
+    cancel_timer_{-1},
+    control_{},
+    stream_{},
+    streaming_{false},
+    stop_requested_{false},
+    restart_stream_{false},
+    rtl_tcp_host_{},
+    rtl_tcp_port_{1234}
 {
-    fft_.setLength(32);
+    // The framing the detection level was tuned on
+    setDetectorFraming(ClickDetector::Framing::Rectangular);
+    detector_.setHandler([this] (auto const& transmission) { onTransmission(transmission); });
+
+    // At most 5 clicks are kept before an activation clears them
+    clicks_.reserve(8);
+    // Size the per-buffer scratch space for librtlsdr's default transfer length
+    samples_.reserve(DEFAULT_BUFFER_LENGTH);
+
+    // 8 kHz leaves room for the tuner's frequency error around an airband voice channel
+    am_demod_.configure(sample_rate_, 16'000U, 8'000.f, 192);
+    audio_.reserve(DEFAULT_BUFFER_LENGTH / 2 / am_demod_.decimation() + 1);
+
+    spectrum_server_.setUnixPath("/tmp/arcal-spectrum.sock");
+
+    // Airband survey: 250 kHz steps cover 8.33 kHz channels within one FFT span
+    scanner_.setRange(118'000'000U, 137'000'000U, 250'000U);
+    scanner_.setDwellTime(std::chrono::milliseconds{100});
+    scanner_.setSettleTime(std::chrono::milliseconds{5});
+    scanner_.setThreshold(-60.f);
+    waterfall_.setTextOutput(show_waterfall_);
+    waterfall_.setSampleRate(sample_rate_);
+    // Same thread count as the FFT, set from the command line
+    waterfall_.setThreads(FFT::threads());
+    // Last core of a Pi 4, below the priority of threaded IRQ handlers (50)
+    realtime_profile_.setCore(3);
+    realtime_profile_.setPriority(40);
+    jitter_.setSampleRate(sample_rate_);
 
     wiringPiSetup();
     pinMode(0, OUTPUT);
@@ -57,7 +141,11 @@ void ARCAL::showBasicInfo(void) noexcept
 
 void ARCAL::showDeviceInfo(void) noexcept
 {
-    auto gains = dev_.listGains();
+    if (! dev_) {
+        return;
+    }
+
+    auto gains = dev_->listGains();
 
     if (! std::get<bool>(gains)) {
         std::cerr << "Failed to list available gains" << std::endl;
@@ -73,14 +161,103 @@ void ARCAL::showDeviceInfo(void) noexcept
     }
 }
 
+void ARCAL::setRealtime(int core, int priority) noexcept
+{
+    realtime_ = true;
+
+    if (core >= 0) {
+        realtime_profile_.setCore(core);
+    }
+
+    if (priority >= 0) {
+        realtime_profile_.setPriority(priority);
+    }
+}
+
+void ARCAL::setJitterMeasurement(bool on) noexcept
+{
+    measure_jitter_ = on;
+}
+
+void ARCAL::setRecording(std::string const& directory)
+{
+    record_iq_ = true;
+    recorder_.setDirectory(directory);
+}
+
+void ARCAL::setSpectrumStream(std::string const& path)
+{
+    stream_spectrum_ = true;
+    spectrum_server_.setUnixPath(path);
+}
+
+void ARCAL::setScan(unsigned int start, unsigned int stop, unsigned int step)
+{
+    scan_enabled_ = true;
+
+    if (step > 0) {
+        scanner_.setRange(start, stop, step);
+    }
+}
+
+void ARCAL::setSpectrumLogging(std::string const& directory)
+{
+    log_spectrum_ = true;
+    spectrum_logger_.setDirectory(directory);
+}
+
+void ARCAL::setAutoGain(bool recalibrate) noexcept
+{
+    auto_gain_ = true;
+    recalibrate_gain_ = recalibrate;
+}
+
+void ARCAL::setAudioOutput(AudioSink::Output output) noexcept
+{
+    demod_audio_ = true;
+    audio_output_ = output;
+}
+
+void ARCAL::setDetectorFraming(ClickDetector::Framing framing)
+{
+    ClickDetector::setupFFT(fft_, framing);
+    detector_.configure(sample_rate_, fft_);
+    fft_bins_.reserve((DEFAULT_BUFFER_LENGTH / 2 / fft_.hop() + 1) * fft_.length() * 2);
+}
+
+void ARCAL::setEnergyGate(bool on) noexcept
+{
+    gate_enabled_ = on;
+}
+
+void ARCAL::setRtlTcp(std::string const& host, unsigned short port)
+{
+    rtl_tcp_host_ = host;
+    rtl_tcp_port_ = port;
+}
+
 void ARCAL::run(void) noexcept
 {
-    showBasicInfo();
+    // stdout carries the audio, so every message goes to stderr for the rest of the process
+    if (demod_audio_ && audio_output_ == AudioSink::Output::Stdout) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    // The USB dongles are irrelevant when samples come from an rtl_tcp server
+    if (rtl_tcp_host_.empty()) {
+        showBasicInfo();
+    }
 
     try {
-        dev_ = Device{0};
+        if (rtl_tcp_host_.empty()) {
+            dev_ = std::make_unique<Device>(0);
+        }
+        else {
+            std::cout << fmt::format("Connecting to rtl_tcp server {}:{}", rtl_tcp_host_, rtl_tcp_port_) << std::endl;
+            dev_ = std::make_unique<TcpSource>(rtl_tcp_host_, rtl_tcp_port_, DEFAULT_BUFFER_LENGTH);
+        }
     }
-    catch (Device::Exception const& ex) {
+    catch (SampleSource::Exception const& ex) {
         std::cerr << fmt::format("Error {}: {}", ex.code(), ex.what()) << std::endl;
         return;
     }
@@ -93,53 +270,198 @@ void ARCAL::run(void) noexcept
     std::cout << fmt::format("DC Compensation: {}", ! std::get<0>(dc_offset_) ? "ON" : "OFF") << std::endl;
     std::cout << std::endl;
 
-    if (! dev_.setCenterFrequency(frequency_)) {
+    if (! dev_->setCenterFrequency(frequency_)) {
         std::cerr << "Failed to set center frequency" << std::endl;
         return;
     }
 
-    if (! dev_.setSampleRate(sample_rate_)) {
+    if (! dev_->setSampleRate(sample_rate_)) {
         std::cerr << "Failed to set sample rate" << std::endl;
         return;
     }
 
-    if (! dev_.setAgcMode(agc_enabled_)) {
+    if (! dev_->setAgcMode(agc_enabled_)) {
         std::cerr << "Failed to set AGC" << std::endl;
     }
 
-    if (! dev_.setGain(rf_gain_)) {
+    if (auto_gain_ && ! agc_enabled_) {
+        auto const cached = recalibrate_gain_ ? std::make_pair(false, 0.f) : GainCalibrator::loadCachedGain(GainCalibrator::defaultCachePath(), gainCacheKey());
+
+        if (std::get<bool>(cached)) {
+            rf_gain_ = std::get<1>(cached);
+            std::cout << fmt::format("Using calibrated gain {:.1f} dB", rf_gain_) << std::endl;
+        }
+        else {
+            auto const gains = dev_->listGains();
+
+            // Short transfers bound the time spent on the old gain after each change, as when scanning
+            dev_->setBufferLength(16384);
+
+            if (std::get<bool>(gains) && gain_calibrator_.start(*dev_, std::get<1>(gains), sample_rate_)) {
+                std::cout << "Calibrating gain, keep the reference signal on the air" << std::endl;
+                calibrating_ = true;
+            }
+            else {
+                std::cerr << "Failed to start gain calibration" << std::endl;
+            }
+        }
+    }
+
+    if (! calibrating_ && ! dev_->setGain(rf_gain_)) {
         std::cerr << "Failed to set gain" << std::endl;
     }
 
-    if (! dev_.resetBuffer()) {
+    // main() blocked them before any thread started, so only the event loop receives them
+    loop_.addSignals({SIGINT, SIGTERM}, [this] (int sig) {
+        std::cout << fmt::format("Caught signal {}, shutting down", sig) << std::endl;
+        requestStop();
+    });
+
+    click_timer_ = loop_.addTimer([this] { expireClicks(); });
+    gpio_timer_ = loop_.addTimer([] { digitalWrite(0, 0); });
+    cancel_timer_ = loop_.addTimer([this] { cancelStream(); });
+
+    if (! control_.open(loop_, "/tmp/arcal-control.sock", [this] (auto const& command) { return onControlCommand(command); })) {
+        std::cerr << "Failed to open control socket" << std::endl;
+    }
+
+    if (journal_enabled_) {
+        journal_.setFrequency(frequency_);
+
+        if (! journal_.open(journal_path_)) {
+            journal_enabled_ = false;
+        }
+    }
+
+    if (record_iq_ && ! recorder_.start(frequency_, sample_rate_, rf_gain_)) {
+        std::cerr << "Failed to start IQ recording" << std::endl;
+        record_iq_ = false;
+    }
+
+    if (stream_spectrum_ && ! spectrum_server_.start(waterfall_.fftLength())) {
+        std::cerr << "Failed to start spectrum server" << std::endl;
+        stream_spectrum_ = false;
+    }
+
+    if (demod_audio_) {
+        audio_sink_.setOutput(audio_output_, audio_output_ == AudioSink::Output::Wav ? "arcal-audio.wav" : "/tmp/arcal-audio.pcm");
+
+        if (audio_sink_.start(am_demod_.audioRate())) {
+            std::cout << fmt::format("AM audio: {} Hz, 16-bit mono", am_demod_.audioRate()) << std::endl;
+        }
+        else {
+            std::cerr << "Failed to start audio output" << std::endl;
+            demod_audio_ = false;
+        }
+    }
+
+    if (log_spectrum_ && ! spectrum_logger_.start(frequency_, sample_rate_, waterfall_.fftLength())) {
+        std::cerr << "Failed to start spectrum logging" << std::endl;
+        log_spectrum_ = false;
+    }
+
+    if (stream_spectrum_ || log_spectrum_) {
+        waterfall_.setSpectrumHandler([this] (auto const& bin_power) {
+            // Zoomed rows cover a narrower span around an offset from the tuned frequency
+            auto const center = static_cast<unsigned int>(static_cast<float>(frequency_) + waterfall_.centerOffset());
+            auto const span = static_cast<unsigned int>(waterfall_.span());
+
+            if (stream_spectrum_) {
+                spectrum_server_.publish(center, span, bin_power);
+            }
+
+            if (log_spectrum_) {
+                spectrum_logger_.onSpectrum(center, span, bin_power);
+            }
+        });
+    }
+
+    if (scan_enabled_) {
+        // Short transfers bound the time spent on the old frequency after each retune
+        dev_->setBufferLength(16384);
+
+        if (! scanner_.start(*dev_, sample_rate_)) {
+            std::cerr << "Failed to start scanner" << std::endl;
+            scan_enabled_ = false;
+        }
+    }
+
+    if (! dev_->resetBuffer()) {
         std::cerr << "Failed to reset buffer" << std::endl;
         return;
     }
 
-    if (! dev_.readAsync([this] (auto&& buffer) { this->onSamples(std::move(buffer)); })) {
-        std::cerr << "Failed to start reading samples" << std::endl;
-        return;
+    // Every buffer of the pipeline exists by now, so locking faults them all in
+    if (realtime_) {
+        realtime_profile_.applyProcess();
+    }
+
+    // The stream thread is the DSP thread, every buffer is processed in its callback
+    streaming_ = true;
+    stream_ = std::thread{[this] {
+        // librtlsdr and TcpSource both deliver buffers on the thread reading them, so this covers USB too
+        if (realtime_) {
+            realtime_profile_.applyThread();
+        }
+
+        // A restart is requested from within onSamples, so on this same thread
+        do {
+            restart_stream_ = false;
+
+            // A stop requested while the thread was starting would find nothing to cancel
+            if (! stop_requested_ && ! dev_->readAsync([this] (auto&& buffer) { this->onSamples(std::move(buffer)); })) {
+                std::cerr << "Failed to start reading samples" << std::endl;
+                break;
+            }
+        } while (restart_stream_ && ! stop_requested_);
+
+        streaming_ = false;
+        loop_.stop();
+    }};
+
+    loop_.run();
+
+    // readAsync only returns once the buffers already received have been processed
+    if (streaming_) {
+        dev_->cancelAsync();
+    }
+
+    stream_.join();
+
+    scanner_.stop();
+    gain_calibrator_.stop();
+    recorder_.stop();
+    spectrum_server_.stop();
+    spectrum_logger_.stop();
+    audio_sink_.stop();
+    journal_.close();
+    control_.close();
+    digitalWrite(0, 0);
+
+    if (measure_jitter_) {
+        std::cout << "Buffer arrival jitter:\n" << jitter_.summary() << std::flush;
     }
 }
 
 float ARCAL::calculateDCOffset(std::vector<std::uint8_t> const& in)
 {
     unsigned int const in_size = in.size();
-    std::vector<float> samples(in_size);
+    float sum = 0.f;
 
-    for (unsigned int n = 0; n < in_size; n += 2) {
+    for (unsigned int n = 0; n < in_size; ++n) {
         // The weird value here is to compensate for DC offset
-        samples[n] = (static_cast<float>(in[n]) - 127.5f);
-        samples[n+1] = (static_cast<float>(in[n+1]) - 127.5f);
+        sum += static_cast<float>(in[n]) - 127.5f;
     }
 
-    return std::accumulate(std::begin(samples), std::end(samples), 0.f) / static_cast<float>(in_size);
+    return sum / static_cast<float>(in_size);
 }
 
-std::vector<float> ARCAL::convertSamples(std::vector<std::uint8_t> const& in, bool block_dc)
+void ARCAL::convertSamples(std::vector<std::uint8_t> const& in, std::vector<float>& out, bool block_dc)
 {
     unsigned int const in_size = in.size();
-    std::vector<float> samples(in_size);
+    // Keeps the capacity from previous buffers
+    out.resize(in_size);
+    float* samples = out.data();
 
     float const offset_value = 127.5f + std::get<1>(dc_offset_);
 
@@ -149,27 +471,42 @@ std::vector<float> ARCAL::convertSamples(std::vector<std::uint8_t> const& in, bo
         samples[n+1] = (static_cast<float>(in[n+1]) - offset_value) * (1.f / 128.f);
     }
 
+    // Before the DC blocker, which would otherwise stretch each spike into a long tail
+    if (blank_noise_) {
+        noise_blanker_.execute(out);
+    }
+
     if (block_dc) {
         for (unsigned int n = 0; n < in_size; n += 2) {
             dc_blocker_.execute(samples[n], samples[n+1]);
         }
     }
+}
 
-    return samples;
+void ARCAL::requestStop(void)
+{
+    stop_requested_ = true;
+    cancelStream();
+}
+
+void ARCAL::cancelStream(void)
+{
+    // Before readAsync() is running there is nothing to cancel, so try again until the stream is done
+    if (streaming_ && ! dev_->cancelAsync()) {
+        loop_.armTimer(cancel_timer_, std::chrono::milliseconds(100));
+    }
 }
 
 void ARCAL::onRemoteActivation(void)
 {
     std::cout << "\033[1;31mREMOTE ACTIVATION DETECTED!!" << std::endl;
 
-    task_ = std::async(
-        std::launch::async,
-        [] {
-            digitalWrite(0, 1);
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            digitalWrite(0, 0);
-        }
-    );
+    ++activations_;
+    journal_.append(EventJournal::Event::Activation);
+
+    // The event loop ends the pulse
+    digitalWrite(0, 1);
+    loop_.armTimer(gpio_timer_, std::chrono::seconds(1));
 }
 
 void ARCAL::verifyClicks(void)
@@ -193,82 +530,243 @@ void ARCAL::verifyClicks(void)
     }
 }
 
-void ARCAL::click(void)
+void ARCAL::scheduleClickExpiry(void)
 {
-    clicks_.insert(std::chrono::steady_clock::now());
-    verifyClicks();
+    if (clicks_.empty()) {
+        loop_.disarmTimer(click_timer_);
+        return;
+    }
+
+    // Just past the moment the oldest click leaves the 5 second window
+    auto const expiry = clicks_.front() + std::chrono::milliseconds(5001);
+    loop_.armTimer(click_timer_, expiry - std::chrono::steady_clock::now());
 }
 
-void ARCAL::detectClicks(std::vector<float> const& fft_samples)
+void ARCAL::expireClicks(void)
 {
-    //! \todo 2021-05-09: add dynamic threshold over noise
-    static float const detection_threshold_ = std::pow(10.f, 10.f / 10.f);
-    //! \todo 2021-05-09: add hold time
-    static unsigned int hold_ = 0;
-    //! \todo 2021-05-09: add noise level estimation
-    static float const noise_level_ = std::pow(10.f, -58.f / 10.f);
-    //! \todo 2021-05-09: consider a click as a transmission of not more than X milliseconds
-    static unsigned int on_time_ = 0;
+    std::lock_guard<std::mutex> lock{clicks_mutex_};
 
-    unsigned int const fft_size = 32;
-    unsigned int const num_fft = fft_samples.size() / (fft_size * 2);
+    auto const count = clicks_.size();
+    verifyClicks();
 
-    for (unsigned int k = 0; k < num_fft; ++k) {
-        auto const* ptr = fft_samples.data() + k * (fft_size * 2);
+    if (clicks_.size() < count) {
+        std::cout << fmt::format("Click window expired, {} click{} discarded", count - clicks_.size(), count - clicks_.size() == 1 ? "" : "s") << std::endl;
+    }
 
-        float power = 0;
+    scheduleClickExpiry();
+}
 
-        for (unsigned int bin = 15; bin <= 17; ++bin) {
-            power += ptr[bin*2]*ptr[bin*2] + ptr[bin*2+1]*ptr[bin*2+1];
-        }
+void ARCAL::click(void)
+{
+    std::lock_guard<std::mutex> lock{clicks_mutex_};
 
-        bool signal_detected = (power >= noise_level_ * detection_threshold_);
+    clicks_.push_back(std::chrono::steady_clock::now());
+    verifyClicks();
+    scheduleClickExpiry();
+}
 
-        if (! signal_detected) {
-            if (hold_ > 0) {
-                --hold_;
-                signal_detected = true;
-            }
-        }
-        else {
-            ++on_time_;
-            // hold_ = 480;   // 2 ms @ 240 kHz
-            hold_ = 80;   // 10 ms @ 8 kHz
+std::string ARCAL::onControlCommand(std::string const& command)
+{
+    if (command == "metrics") {
+        std::size_t pending_clicks = 0;
+        {
+            std::lock_guard<std::mutex> lock{clicks_mutex_};
+            pending_clicks = clicks_.size();
         }
 
-        if (! signal_detected && signal_present_) {
-            std::cout << fmt::format(
-                "Signal lost, duration: {:.1f} ms / {} samples",
-                on_time_ * 1.f / 8.f,
-                on_time_
-            ) << std::endl;
+        return fmt::format(
+            "buffers {}\ngated_buffers {}\nactivations {}\npending_clicks {}\nrecorder_dropped_samples {}\nspectrum_logger_dropped_rows {}\naudio_dropped_samples {}\njournal_dropped_records {}\nblanked_samples {}\n",
+            buffer_count_.load(),
+            gated_buffers_.load(),
+            activations_.load(),
+            pending_clicks,
+            recorder_.droppedSamples(),
+            spectrum_logger_.droppedRows(),
+            audio_sink_.droppedSamples(),
+            journal_.droppedRecords(),
+            noise_blanker_.blankedSamples()
+        ) + (measure_jitter_ ? jitter_.summary() : std::string{});
+    }
+
+    if (command.compare(0, 4, "zoom") == 0) {
+        std::istringstream args{command.substr(4)};
+        float offset = 0.f;
+        float span = 0.f;
 
-            if (on_time_ >= 160) { // 20 ms @ 8 kHz
-                click();
+        // "zoom <offset_hz> <span_hz>" narrows the waterfall, "zoom off" restores the full band
+        if (args >> offset >> span && span > 0.f && std::fabs(offset) + span / 2.f <= sample_rate_ / 2.f) {
+            if (! waterfall_.setZoom(offset, span)) {
+                return fmt::format("span too narrow, at least {:.0f} Hz\n", std::ceil(static_cast<float>(sample_rate_) / Waterfall::MAX_ZOOM_DECIMATION));
             }
+
+            return fmt::format("ok, {:.0f} Hz bins\n", sample_rate_ / std::floor(sample_rate_ / span) / waterfall_.fftLength());
         }
 
-        if (! signal_detected) {
-            on_time_ = 0;
+        if (command == "zoom off") {
+            waterfall_.setZoom(0.f, 0.f);
+            return "ok\n";
         }
 
-        signal_present_ = signal_detected;
+        return "usage: zoom <offset_hz> <span_hz> | zoom off\n";
+    }
+
+    if (command == "quit") {
+        requestStop();
+        return "ok\n";
+    }
+
+    return fmt::format("unknown command '{}', expected metrics, zoom or quit\n", command);
+}
+
+void ARCAL::onTransmission(ClickDetector::Transmission const& transmission)
+{
+    // Formatted on the stack, this runs on the DSP thread where the heap is off limits
+    fmt::memory_buffer message;
+    fmt::format_to(std::back_inserter(message), "Signal lost, duration: {:.1f} ms / {} samples", transmission.duration_ms_, transmission.frames_);
+    std::cout.write(message.data(), message.size()) << std::endl;
+
+    // Both edges are dated from their frames rather than from when the handler runs
+    auto const end = frameTime(detector_.frameCount());
+    auto const duration_us = static_cast<std::uint32_t>(transmission.duration_ms_ * 1000.f);
+
+    journal_.append(EventJournal::Event::SignalOn, frameTime(transmission.start_frame_), 0, 0);
+    journal_.append(EventJournal::Event::SignalOff, end, duration_us, 0);
+
+    if (transmission.click_) {
+        journal_.append(EventJournal::Event::Click, end, duration_us, 0);
+        click();
+    }
+}
+
+std::chrono::system_clock::time_point ARCAL::frameTime(std::uint64_t frame) const
+{
+    // Frames before the current buffer give a negative offset
+    auto const offset_ms = static_cast<double>(static_cast<std::int64_t>(frame - buffer_frame_)) / detector_.framesPerMs();
+
+    return buffer_time_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double, std::milli>(offset_ms));
+}
+
+std::string ARCAL::gainCacheKey(void) const
+{
+    if (! rtl_tcp_host_.empty()) {
+        return fmt::format("rtl_tcp:{}:{}", rtl_tcp_host_, rtl_tcp_port_);
     }
+
+    auto const devices = Device::listDevices();
+
+    if (devices.empty()) {
+        return "unknown";
+    }
+
+    // Dongles without a serial fall back to their name, which is shared by the same model
+    auto key = std::get<4>(devices.front()).empty() ? std::get<1>(devices.front()) : std::get<4>(devices.front());
+    std::replace(std::begin(key), std::end(key), ' ', '_');
+
+    return key;
+}
+
+void ARCAL::finishGainCalibration(void)
+{
+    rf_gain_ = gain_calibrator_.bestGain();
+    recorder_.setGain(rf_gain_);
+
+    if (! GainCalibrator::storeCachedGain(GainCalibrator::defaultCachePath(), gainCacheKey(), rf_gain_)) {
+        std::cerr << "Failed to store calibrated gain" << std::endl;
+    }
+
+    // Back to full transfers, unless the scanner still wants short ones. rtl_tcp reads
+    // pick up the length from the next buffer, librtlsdr only from the next readAsync()
+    if (! scan_enabled_) {
+        dev_->setBufferLength(DEFAULT_BUFFER_LENGTH);
+
+        if (rtl_tcp_host_.empty()) {
+            restart_stream_ = true;
+            dev_->cancelAsync();
+        }
+    }
+
+    calibrating_ = false;
 }
 
 void ARCAL::onSamples(std::vector<std::uint8_t>&& in)
 {
+    // The buffer's last sample arrived just now, so its first one is a buffer length earlier
+    buffer_time_ = std::chrono::system_clock::now() - std::chrono::microseconds(in.size() / 2 * 1'000'000ULL / sample_rate_);
+    buffer_frame_ = detector_.frameCount();
+
+    if (measure_jitter_) {
+        jitter_.onBuffer(in.size() / 2);
+    }
+
+    // The sweep runs before the warm-up count starts, since writing the cache allocates
+    if (calibrating_) {
+        if (gain_calibrator_.onSamples(in)) {
+            finishGainCalibration();
+        }
+
+        return;
+    }
+
+    // Scanning replaces the detector, and copying its pass statistics is allowed to allocate
+    if (scan_enabled_) {
+        scanner_.onSamples(in);
+        return;
+    }
+
+    bool const check_allocations = ++buffer_count_ > ALLOCATION_WARMUP_BUFFERS;
+
+    if (check_allocations) {
+        AllocationCounter::arm();
+    }
+
+    if (record_iq_) {
+        auto const dropped = recorder_.onSamples(in);
+
+        if (dropped > 0) {
+            journal_.append(EventJournal::Event::Drop, 0, dropped);
+        }
+    }
+
     if (! std::get<0>(dc_offset_)) {
         std::get<1>(dc_offset_) = calculateDCOffset(in);
         std::get<0>(dc_offset_) = true;
+        gate_.setDCOffset(std::get<1>(dc_offset_));
+    }
+
+    bool const active = ! gate_enabled_ || gate_.execute(in);
+    // The text waterfall pauses while the gate is closed, so an idle channel costs
+    // neither the conversion nor the waterfall FFT; streamed and logged rows stay continuous
+    bool const show_spectrum = (show_waterfall_ && active) || stream_spectrum_ || log_spectrum_;
+
+    // Audio runs on the same converted samples; note that filter_dc_ would strip the AM carrier
+    if (active || show_spectrum || demod_audio_) {
+        convertSamples(in, samples_, filter_dc_);
+    }
+
+    if (active) {
+        fft_.execute(samples_, fft_bins_);
+        detector_.execute(fft_bins_);
+    }
+    else {
+        ++gated_buffers_;
+        detector_.skip(fft_.skip(in.size() / 2));
+    }
+
+    if (show_spectrum) {
+        waterfall_.onSamples(samples_);
     }
 
-    auto samples = convertSamples(in, filter_dc_);
-    auto fft_bins = fft_.execute(samples);
+    if (demod_audio_) {
+        am_demod_.execute(samples_, audio_);
+        audio_sink_.write(audio_);
+    }
 
-    detectClicks(fft_bins);
+    if (check_allocations) {
+        AllocationCounter::disarm();
 
-    if (show_waterfall_) {
-        waterfall_.onSamples(samples);
+        if (AllocationCounter::count() > 0) {
+            std::cerr << fmt::format("{} heap allocations after warm-up, aborting", AllocationCounter::count()) << std::endl;
+            std::abort();
+        }
     }
 }
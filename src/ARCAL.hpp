@@ -8,16 +8,35 @@
 #define JDRADIO_ARCAL_HPP
 
 #include "Device.hpp"
+#include "TcpSource.hpp"
+#include "AllocationCounter.hpp"
 #include "FFT.hpp"
 #include "DCBlocker.hpp"
+#include "EnergyGate.hpp"
+#include "NoiseBlanker.hpp"
+#include "ClickDetector.hpp"
+#include "EventJournal.hpp"
+#include "EventLoop.hpp"
+#include "ControlSocket.hpp"
 #include "Waterfall.hpp"
+#include "Recorder.hpp"
+#include "SpectrumServer.hpp"
+#include "SpectrumLogger.hpp"
+#include "Scanner.hpp"
+#include "GainCalibrator.hpp"
+#include "AMDemodulator.hpp"
+#include "AudioSink.hpp"
+#include "RealtimeProfile.hpp"
+#include "JitterMeter.hpp"
 #include <string>
 #include <vector>
 #include <array>
 #include <utility>
 #include <chrono>
-#include <set>
-#include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 class ARCAL
 {
@@ -26,31 +45,106 @@ public:
 
     void showBasicInfo(void) noexcept;
     void showDeviceInfo(void) noexcept;
+    //! A negative core or priority keeps the default, core 3 at priority 40
+    void setRealtime(int core, int priority) noexcept;
+    void setJitterMeasurement(bool on) noexcept;
+    //! Continuous SigMF recording of the raw samples
+    void setRecording(std::string const& directory);
+    //! Binary spectrum rows to clients of a UNIX socket
+    void setSpectrumStream(std::string const& path);
+    //! Hops over the range instead of running the detector; zero steps keep the airband survey
+    void setScan(unsigned int start, unsigned int stop, unsigned int step);
+    //! Averaged spectrum rows saved as image tiles
+    void setSpectrumLogging(std::string const& directory);
+    //! Picks the gain with the best SNR on a reference signal, cached per device
+    void setAutoGain(bool recalibrate) noexcept;
+    //! AM audio of the tuned channel, 16-bit mono
+    void setAudioOutput(AudioSink::Output output) noexcept;
+    //! Hann frames with half overlap double the detector's time resolution
+    void setDetectorFraming(ClickDetector::Framing framing);
+    //! Skips the detector, and the text waterfall, while nothing is near the channel
+    void setEnergyGate(bool on) noexcept;
+    //! Samples come from an rtl_tcp server instead of the first USB dongle
+    void setRtlTcp(std::string const& host, unsigned short port);
     void run(void) noexcept;
     void onSamples(std::vector<std::uint8_t>&& in);
 
 private:
-    std::vector<float> convertSamples(std::vector<std::uint8_t> const& in, bool block_dc);
+    void convertSamples(std::vector<std::uint8_t> const& in, std::vector<float>& out, bool block_dc);
     float calculateDCOffset(std::vector<std::uint8_t> const& in);
     void click(void);
-    void detectClicks(std::vector<float> const& fft_samples);
+    void onTransmission(ClickDetector::Transmission const& transmission);
+    std::chrono::system_clock::time_point frameTime(std::uint64_t frame) const;
     void verifyClicks(void);
+    void expireClicks(void);
+    void scheduleClickExpiry(void);
     void onRemoteActivation(void);
+    void requestStop(void);
+    void cancelStream(void);
+    std::string onControlCommand(std::string const& command);
+    std::string gainCacheKey(void) const;
+    void finishGainCalibration(void);
 
-    Device dev_;
+    std::unique_ptr<SampleSource> dev_;
     DCBlocker dc_blocker_;
     Waterfall waterfall_;
     std::pair<bool, float> dc_offset_;
     bool filter_dc_;
+    NoiseBlanker noise_blanker_;
+    bool blank_noise_;
     unsigned int frequency_;
     unsigned int sample_rate_;
     bool agc_enabled_;
     float rf_gain_;
-    bool signal_present_;
-    std::set<std::chrono::steady_clock::time_point> clicks_;
+    ClickDetector detector_;
+    EventJournal journal_;
+    bool journal_enabled_;
+    std::string journal_path_;
+    std::vector<std::chrono::steady_clock::time_point> clicks_;
+    std::mutex clicks_mutex_;
     FFT fft_;
     bool show_waterfall_;
-    std::future<void> task_;
+    Recorder recorder_;
+    bool record_iq_;
+    SpectrumServer spectrum_server_;
+    bool stream_spectrum_;
+    SpectrumLogger spectrum_logger_;
+    bool log_spectrum_;
+    Scanner scanner_;
+    bool scan_enabled_;
+    GainCalibrator gain_calibrator_;
+    bool auto_gain_;
+    bool recalibrate_gain_;
+    std::atomic<bool> calibrating_;
+    AMDemodulator am_demod_;
+    AudioSink audio_sink_;
+    bool demod_audio_;
+    AudioSink::Output audio_output_;
+    std::vector<std::int16_t> audio_;
+    std::vector<float> samples_;
+    std::vector<float> fft_bins_;
+    std::chrono::system_clock::time_point buffer_time_;
+    std::uint64_t buffer_frame_;
+    std::atomic<std::uint64_t> buffer_count_;
+    EnergyGate gate_;
+    bool gate_enabled_;
+    std::atomic<std::uint64_t> gated_buffers_;
+    std::atomic<std::uint64_t> activations_;
+    RealtimeProfile realtime_profile_;
+    bool realtime_;
+    JitterMeter jitter_;
+    bool measure_jitter_;
+    EventLoop loop_;
+    int click_timer_;
+    int gpio_timer_;
+    int cancel_timer_;
+    ControlSocket control_;
+    std::thread stream_;
+    std::atomic<bool> streaming_;
+    std::atomic<bool> stop_requested_;
+    bool restart_stream_;
+    std::string rtl_tcp_host_;
+    unsigned short rtl_tcp_port_;
 };
 
 #endif
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "AllocationCounter.hpp"
+
+#ifdef ARCAL_COUNT_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static thread_local bool armed_ = false;
+static std::atomic<std::size_t> count_{0};
+
+void AllocationCounter::arm(void) noexcept
+{
+    armed_ = true;
+}
+
+void AllocationCounter::disarm(void) noexcept
+{
+    armed_ = false;
+}
+
+std::size_t AllocationCounter::count(void) noexcept
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+static void* allocate(std::size_t size) noexcept
+{
+    if (armed_) {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new(std::size_t size)
+{
+    void* ptr = allocate(size);
+
+    if (! ptr) {
+        throw std::bad_alloc{};
+    }
+
+    return ptr;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
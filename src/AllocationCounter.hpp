@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_ALLOCATIONCOUNTER_HPP
+#define JDRADIO_ALLOCATIONCOUNTER_HPP
+
+#include <cstddef>
+
+//! Counts heap allocations made by the calling thread while armed.
+//!
+//! Only active when built with ARCAL_COUNT_ALLOCATIONS, which replaces the
+//! global operator new. Otherwise every call compiles to nothing.
+class AllocationCounter
+{
+public:
+#ifdef ARCAL_COUNT_ALLOCATIONS
+    static void arm(void) noexcept;
+    static void disarm(void) noexcept;
+    static std::size_t count(void) noexcept;
+#else
+    static void arm(void) noexcept {}
+    static void disarm(void) noexcept {}
+    static std::size_t count(void) noexcept { return 0; }
+#endif
+};
+
+#endif
@@ -0,0 +1,307 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "AudioSink.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <system_error>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//! Pipe size for the FIFO output, a fraction of a second of audio
+static constexpr int FIFO_CAPACITY = 8192;
+
+template<class T>
+static std::uint8_t* put(std::uint8_t* ptr, T value)
+{
+    std::memcpy(ptr, &value, sizeof(T));
+    return ptr + sizeof(T);
+}
+
+//! Canonical 44-byte PCM header, sizes left open while streaming
+static void makeWavHeader(std::uint8_t* header, unsigned int sample_rate, std::uint32_t data_size)
+{
+    auto* ptr = header;
+    std::memcpy(ptr, "RIFF", 4);
+    ptr = put(ptr + 4, static_cast<std::uint32_t>(data_size == 0xFFFFFFFFU ? data_size : data_size + 36));
+    std::memcpy(ptr, "WAVEfmt ", 8);
+    ptr = put(ptr + 8, static_cast<std::uint32_t>(16));
+    ptr = put(ptr, static_cast<std::uint16_t>(1));
+    ptr = put(ptr, static_cast<std::uint16_t>(1));
+    ptr = put(ptr, static_cast<std::uint32_t>(sample_rate));
+    ptr = put(ptr, static_cast<std::uint32_t>(sample_rate * 2));
+    ptr = put(ptr, static_cast<std::uint16_t>(2));
+    ptr = put(ptr, static_cast<std::uint16_t>(16));
+    std::memcpy(ptr, "data", 4);
+    put(ptr + 4, data_size);
+}
+
+AudioSink::AudioSink(void) noexcept :
+    output_{Output::Fifo},
+    path_{"/tmp/arcal-audio.pcm"},
+    buffer_length_{16000},
+    sample_rate_{0},
+    fd_{-1},
+    data_size_{0},
+    ring_{},
+    head_{0},
+    used_{0},
+    dropped_samples_{0},
+    mutex_{},
+    cv_{},
+    writer_{},
+    running_{false}
+{
+}
+
+AudioSink::~AudioSink(void) noexcept
+{
+    stop();
+}
+
+void AudioSink::setOutput(Output output, std::string const& path)
+{
+    output_ = output;
+    path_ = path;
+}
+
+void AudioSink::setBufferLength(std::size_t samples)
+{
+    buffer_length_ = std::max<std::size_t>(1024, samples);
+}
+
+bool AudioSink::start(unsigned int sample_rate)
+{
+    if (running_) {
+        return false;
+    }
+
+    sample_rate_ = sample_rate;
+
+    if (! openOutput()) {
+        return false;
+    }
+
+    ring_.assign(buffer_length_, 0);
+    head_ = 0;
+    used_ = 0;
+    dropped_samples_ = 0;
+    running_ = true;
+
+    try {
+        writer_ = std::thread{&AudioSink::writerLoop, this};
+    }
+    catch (std::system_error const&) {
+        running_ = false;
+        closeOutput();
+        return false;
+    }
+
+    return true;
+}
+
+void AudioSink::stop(void) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    cv_.notify_one();
+
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+
+    closeOutput();
+}
+
+void AudioSink::write(std::vector<std::int16_t> const& samples) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        std::size_t const size = ring_.size();
+        std::size_t const count = std::min(samples.size(), size - used_);
+        std::size_t const tail = (head_ + used_) % size;
+        std::size_t const first = std::min(count, size - tail);
+
+        std::memcpy(ring_.data() + tail, samples.data(), first * sizeof(std::int16_t));
+        std::memcpy(ring_.data(), samples.data() + first, (count - first) * sizeof(std::int16_t));
+        used_ += count;
+        dropped_samples_ += samples.size() - count;
+    }
+
+    cv_.notify_one();
+}
+
+std::uint64_t AudioSink::droppedSamples(void) const noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return dropped_samples_;
+}
+
+bool AudioSink::openOutput(void)
+{
+    data_size_ = 0;
+
+    switch (output_) {
+    case Output::Stdout:
+        // The audio keeps its own copy of stdout and fd 1 goes to stderr, so text
+        // printed by anything in the process, C stdio included, stays out of the PCM
+        fd_ = ::dup(STDOUT_FILENO);
+
+        if (fd_ >= 0 && ::dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        break;
+
+    case Output::Fifo:
+        if (::mkfifo(path_.c_str(), 0644) < 0 && errno != EEXIST) {
+            std::cerr << fmt::format("Failed to create {}: {}", path_, std::strerror(errno)) << std::endl;
+            return false;
+        }
+
+        // Read-write so the open does not wait for a listener and the pipe survives the
+        // listener going away. A small pipe bounds the stale audio a new listener hears.
+        fd_ = ::open(path_.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+
+        if (fd_ >= 0) {
+            ::fcntl(fd_, F_SETPIPE_SZ, FIFO_CAPACITY);
+        }
+        break;
+
+    case Output::Wav: {
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        std::uint8_t header[44];
+        makeWavHeader(header, sample_rate_, 0xFFFFFFFFU);
+
+        if (fd_ >= 0 && ! writeAll(header, sizeof(header))) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        break;
+    }
+    }
+
+    if (fd_ < 0) {
+        std::cerr << fmt::format("Failed to open {}: {}", path_, std::strerror(errno)) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void AudioSink::writerLoop(void)
+{
+    std::vector<std::int16_t> chunk(ring_.size());
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        cv_.wait(lock, [this] { return used_ > 0 || ! running_; });
+
+        if (used_ == 0) {
+            break;
+        }
+
+        std::size_t const size = ring_.size();
+        std::size_t const count = used_;
+        std::size_t const first = std::min(count, size - head_);
+
+        std::memcpy(chunk.data(), ring_.data() + head_, first * sizeof(std::int16_t));
+        std::memcpy(chunk.data() + first, ring_.data(), (count - first) * sizeof(std::int16_t));
+        head_ = (head_ + count) % size;
+        used_ -= count;
+        lock.unlock();
+
+        if (writeAll(chunk.data(), count * sizeof(std::int16_t))) {
+            data_size_ += count * sizeof(std::int16_t);
+        }
+
+        lock.lock();
+    }
+}
+
+void AudioSink::discardFifo(void)
+{
+    std::uint8_t buffer[4096];
+
+    while (::read(fd_, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+bool AudioSink::writeAll(void const* data, std::size_t size)
+{
+    auto const* ptr = static_cast<std::uint8_t const*>(data);
+    bool discarded = false;
+
+    while (size > 0) {
+        // Pipe writes up to PIPE_BUF are all or nothing, so a full FIFO never splits a sample
+        std::size_t const chunk = output_ == Output::Fifo ? std::min<std::size_t>(size, PIPE_BUF) : size;
+        ssize_t result = ::write(fd_, ptr, chunk);
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            // A full FIFO means nobody is keeping up: the old audio is thrown away
+            // so whoever listens next starts from the latest samples
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && output_ == Output::Fifo && ! discarded) {
+                discardFifo();
+                discarded = true;
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << fmt::format("Failed to write audio: {}", std::strerror(errno)) << std::endl;
+            }
+
+            return false;
+        }
+
+        ptr += result;
+        size -= result;
+    }
+
+    return true;
+}
+
+void AudioSink::closeOutput(void)
+{
+    if (fd_ < 0) {
+        return;
+    }
+
+    if (output_ == Output::Wav) {
+        std::uint8_t header[44];
+        makeWavHeader(header, sample_rate_, static_cast<std::uint32_t>(std::min<std::uint64_t>(data_size_, 0xFFFFFFFFU - 36)));
+        ::pwrite(fd_, header, sizeof(header), 0);
+    }
+
+    if (output_ == Output::Stdout) {
+        ::dup2(fd_, STDOUT_FILENO);
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+}
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_AUDIOSINK_HPP
+#define JDRADIO_AUDIOSINK_HPP
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//! Writes 16-bit mono PCM to stdout, a named pipe or a WAV file.
+//!
+//! Samples go through a ring buffer to a writer thread, so a slow reader or
+//! disk never stalls the caller; when the ring is full, samples are dropped.
+//! The FIFO is opened read-write so the writer never waits for a listener;
+//! when nobody drains it, stale audio is discarded rather than queued. The
+//! WAV header sizes are filled in when the sink stops.
+class AudioSink
+{
+public:
+    enum class Output
+    {
+        Stdout,
+        Fifo,
+        Wav,
+    };
+
+    AudioSink(void) noexcept;
+    ~AudioSink(void) noexcept;
+
+    void setOutput(Output output, std::string const& path);
+    void setBufferLength(std::size_t samples);
+
+    bool start(unsigned int sample_rate);
+    void stop(void) noexcept;
+    void write(std::vector<std::int16_t> const& samples) noexcept;
+    std::uint64_t droppedSamples(void) const noexcept;
+
+private:
+    bool openOutput(void);
+    void writerLoop(void);
+    bool writeAll(void const* data, std::size_t size);
+    void discardFifo(void);
+    void closeOutput(void);
+
+    Output output_;
+    std::string path_;
+    std::size_t buffer_length_;
+    unsigned int sample_rate_;
+    int fd_;
+    std::uint64_t data_size_;
+
+    std::vector<std::int16_t> ring_;
+    std::size_t head_;
+    std::size_t used_;
+    std::uint64_t dropped_samples_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread writer_;
+    bool running_;
+};
+
+#endif
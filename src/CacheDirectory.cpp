@@ -0,0 +1,31 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "CacheDirectory.hpp"
+#include <cstdlib>
+#include <fmt/format.h>
+#include <sys/stat.h>
+
+std::string CacheDirectory::path(void)
+{
+    std::string dir;
+
+    if (auto const* xdg = std::getenv("XDG_CACHE_HOME")) {
+        dir = xdg;
+    }
+    else if (auto const* home = std::getenv("HOME")) {
+        dir = fmt::format("{}/.cache", home);
+    }
+    else {
+        dir = "/tmp";
+    }
+
+    ::mkdir(dir.c_str(), 0755);
+    dir += "/arcal";
+    ::mkdir(dir.c_str(), 0755);
+
+    return dir;
+}
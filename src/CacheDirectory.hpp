@@ -0,0 +1,21 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_CACHEDIRECTORY_HPP
+#define JDRADIO_CACHEDIRECTORY_HPP
+
+#include <string>
+
+//! Where ARCAL keeps what it learns about the host between runs: FFTW wisdom,
+//! calibrated gains. $XDG_CACHE_HOME/arcal, ~/.cache/arcal or /tmp/arcal,
+//! created on first use.
+class CacheDirectory
+{
+public:
+    static std::string path(void);
+};
+
+#endif
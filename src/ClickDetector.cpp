@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "ClickDetector.hpp"
+#include <cmath>
+
+ClickDetector::ClickDetector(void) noexcept :
+    fft_length_{32},
+    frames_per_ms_{1.f},
+    noise_bandwidth_{1.f},
+    detection_level_{0.f},
+    //! \todo 2021-05-09: add dynamic threshold over noise
+    threshold_{10.f},
+    //! \todo 2021-05-09: add noise level estimation
+    noise_level_{-58.f},
+    hold_time_{10.f},
+    //! \todo 2021-05-09: consider a click as a transmission of not more than X milliseconds
+    min_click_duration_{20.f},
+    signal_present_{false},
+    hold_{0},
+    on_time_{0},
+    frame_count_{0},
+    start_frame_{0},
+    handler_{nullptr}
+{
+    updateDetectionLevel();
+}
+
+void ClickDetector::setupFFT(FFT& fft, Framing framing)
+{
+    fft.setLength(32);
+
+    switch (framing) {
+    case Framing::Rectangular:
+        fft.setWindow(FFT::Window::Rectangular);
+        fft.setOverlap(0.f);
+        break;
+    case Framing::HannOverlapped:
+        fft.setWindow(FFT::Window::Hann);
+        fft.setOverlap(0.5f);
+        break;
+    }
+}
+
+void ClickDetector::configure(unsigned int sample_rate, FFT const& fft) noexcept
+{
+    fft_length_ = fft.length();
+    // FFT frames per millisecond, which depends on the overlap
+    frames_per_ms_ = sample_rate / 1000.f / fft.hop();
+    noise_bandwidth_ = fft.noiseBandwidth();
+    updateDetectionLevel();
+
+    signal_present_ = false;
+    hold_ = 0;
+    on_time_ = 0;
+    frame_count_ = 0;
+}
+
+void ClickDetector::setThreshold(float db) noexcept
+{
+    threshold_ = db;
+    updateDetectionLevel();
+}
+
+void ClickDetector::setNoiseLevel(float db) noexcept
+{
+    noise_level_ = db;
+    updateDetectionLevel();
+}
+
+void ClickDetector::setHoldTime(float ms) noexcept
+{
+    hold_time_ = ms;
+}
+
+void ClickDetector::setMinClickDuration(float ms) noexcept
+{
+    min_click_duration_ = ms;
+}
+
+void ClickDetector::setHandler(std::function<void(Transmission const&)> handler)
+{
+    handler_ = handler;
+}
+
+void ClickDetector::execute(std::vector<float> const& fft_samples)
+{
+    unsigned int const fft_size = fft_length_;
+    unsigned int const num_fft = fft_samples.size() / (fft_size * 2);
+    unsigned int const hold_frames = static_cast<unsigned int>(hold_time_ * frames_per_ms_);
+
+    for (unsigned int k = 0; k < num_fft; ++k, ++frame_count_) {
+        auto const* ptr = fft_samples.data() + k * (fft_size * 2);
+
+        float power = 0;
+
+        for (unsigned int bin = fft_size / 2 - 1; bin <= fft_size / 2 + 1; ++bin) {
+            power += ptr[bin*2]*ptr[bin*2] + ptr[bin*2+1]*ptr[bin*2+1];
+        }
+
+        bool signal_detected = (power >= detection_level_);
+
+        if (! signal_detected) {
+            if (hold_ > 0) {
+                --hold_;
+                signal_detected = true;
+            }
+        }
+        else {
+            if (! signal_present_) {
+                start_frame_ = frame_count_;
+            }
+
+            ++on_time_;
+            hold_ = hold_frames;
+        }
+
+        if (! signal_detected && signal_present_) {
+            onSignalLost();
+        }
+
+        if (! signal_detected) {
+            on_time_ = 0;
+        }
+
+        signal_present_ = signal_detected;
+    }
+}
+
+void ClickDetector::skip(unsigned int frames)
+{
+    // Same as feeding execute() with frames that contain no signal
+    if (! signal_present_ || frames == 0) {
+        frame_count_ += frames;
+        return;
+    }
+
+    if (hold_ >= frames) {
+        hold_ -= frames;
+        frame_count_ += frames;
+        return;
+    }
+
+    // The transmission ends on the frame where the hold runs out
+    unsigned int const held = hold_;
+    frame_count_ += held;
+    hold_ = 0;
+    onSignalLost();
+    frame_count_ += frames - held;
+    on_time_ = 0;
+    signal_present_ = false;
+}
+
+float ClickDetector::framesPerMs(void) const noexcept
+{
+    return frames_per_ms_;
+}
+
+std::uint64_t ClickDetector::frameCount(void) const noexcept
+{
+    return frame_count_;
+}
+
+void ClickDetector::onSignalLost(void)
+{
+    if (handler_) {
+        handler_(Transmission{start_frame_, on_time_, on_time_ / frames_per_ms_, on_time_ >= min_click_duration_ * frames_per_ms_});
+    }
+}
+
+void ClickDetector::updateDetectionLevel(void) noexcept
+{
+    // The noise level was measured on rectangular frames, whose noise bandwidth is one bin
+    detection_level_ = std::pow(10.f, (noise_level_ + threshold_) / 10.f) * noise_bandwidth_;
+}
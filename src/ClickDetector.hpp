@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_CLICKDETECTOR_HPP
+#define JDRADIO_CLICKDETECTOR_HPP
+
+#include "FFT.hpp"
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+//! Finds transmissions on the carrier at the center of the spectrum.
+//!
+//! Works on the frames produced by FFT::execute. A frame carries signal when
+//! the three center bins rise above the noise level by the threshold, and a
+//! short hold bridges dropouts. When a transmission ends, the handler gets
+//! its start frame and its duration; one lasting at least the minimum click
+//! duration is a click. All state lives in the instance, so any number of
+//! detectors can run side by side.
+//!
+//! The noise level and threshold were tuned on rectangular 32-point frames
+//! without overlap. Hann frames with half overlap double the time resolution;
+//! a windowed carrier keeps its peak bin, since the FFT normalizes by the
+//! window sum, but the noise in each bin grows by the window's noise
+//! bandwidth, so the detection level is raised by the same factor.
+class ClickDetector
+{
+public:
+    struct Transmission
+    {
+        std::uint64_t start_frame_;
+        unsigned int frames_;
+        float duration_ms_;
+        bool click_;
+    };
+
+    enum class Framing
+    {
+        Rectangular,
+        HannOverlapped,
+    };
+
+    ClickDetector(void) noexcept;
+
+    //! Sets up the detector's FFT; live and batch detection share it so their results match
+    static void setupFFT(FFT& fft, Framing framing);
+
+    void configure(unsigned int sample_rate, FFT const& fft) noexcept;
+    void setThreshold(float db) noexcept;
+    void setNoiseLevel(float db) noexcept;
+    void setHoldTime(float ms) noexcept;
+    void setMinClickDuration(float ms) noexcept;
+    void setHandler(std::function<void(Transmission const&)> handler);
+
+    void execute(std::vector<float> const& fft_samples);
+    void skip(unsigned int frames);
+    float framesPerMs(void) const noexcept;
+    std::uint64_t frameCount(void) const noexcept;
+
+private:
+    void onSignalLost(void);
+    void updateDetectionLevel(void) noexcept;
+
+    unsigned int fft_length_;
+    float frames_per_ms_;
+    float noise_bandwidth_;
+    float detection_level_;
+    float threshold_;
+    float noise_level_;
+    float hold_time_;
+    float min_click_duration_;
+    bool signal_present_;
+    unsigned int hold_;
+    unsigned int on_time_;
+    std::uint64_t frame_count_;
+    std::uint64_t start_frame_;
+    std::function<void(Transmission const&)> handler_;
+};
+
+#endif
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "ControlSocket.hpp"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fmt/format.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+ControlSocket::ControlSocket(void) noexcept :
+    loop_{nullptr},
+    path_{},
+    fd_{-1},
+    handler_{nullptr}
+{
+}
+
+ControlSocket::~ControlSocket(void) noexcept
+{
+    close();
+}
+
+bool ControlSocket::open(EventLoop& loop, std::string const& path, std::function<std::string(std::string const&)> handler)
+{
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    ::unlink(path.c_str());
+
+    if (fd_ < 0 || ::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd_, 4) < 0) {
+        std::cerr << fmt::format("Failed to listen on {}: {}", path, std::strerror(errno)) << std::endl;
+        close();
+        return false;
+    }
+
+    loop_ = &loop;
+    path_ = path;
+    handler_ = handler;
+
+    if (! loop_->add(fd_, [this] { acceptClient(); })) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void ControlSocket::close(void) noexcept
+{
+    if (fd_ < 0) {
+        return;
+    }
+
+    if (loop_) {
+        loop_->remove(fd_);
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+
+    if (! path_.empty()) {
+        ::unlink(path_.c_str());
+    }
+}
+
+void ControlSocket::acceptClient(void)
+{
+    int fd = ::accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) {
+        return;
+    }
+
+    if (! loop_->add(fd, [this, fd] { onClient(fd); })) {
+        ::close(fd);
+    }
+}
+
+void ControlSocket::onClient(int fd)
+{
+    char buffer[256];
+    ssize_t result = ::recv(fd, buffer, sizeof(buffer) - 1, 0);
+
+    if (result < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+
+    if (result > 0) {
+        std::string command{buffer, static_cast<std::size_t>(result)};
+        command.erase(command.find_last_not_of(" \r\n") + 1);
+
+        auto reply = handler_(command);
+        ::send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+    }
+
+    loop_->remove(fd);
+    ::close(fd);
+}
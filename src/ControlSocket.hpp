@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_CONTROLSOCKET_HPP
+#define JDRADIO_CONTROLSOCKET_HPP
+
+#include "EventLoop.hpp"
+#include <string>
+#include <functional>
+
+//! Line based command socket served from an EventLoop.
+//!
+//! A client connects, sends one command line and receives the reply, then the
+//! connection is closed, e.g. `echo metrics | socat - UNIX:/tmp/arcal-control.sock`.
+class ControlSocket
+{
+public:
+    ControlSocket(void) noexcept;
+    ~ControlSocket(void) noexcept;
+
+    bool open(EventLoop& loop, std::string const& path, std::function<std::string(std::string const&)> handler);
+    void close(void) noexcept;
+
+private:
+    void acceptClient(void);
+    void onClient(int fd);
+
+    EventLoop* loop_;
+    std::string path_;
+    int fd_;
+    std::function<std::string(std::string const&)> handler_;
+};
+
+#endif
@@ -10,14 +10,18 @@
 Device::Device(void) noexcept :
     mutex_{},
     dev_{nullptr},
-    handler_{nullptr}
+    handler_{nullptr},
+    buffer_{},
+    buffer_length_{0}
 {
 }
 
 Device::Device(Device&& other) noexcept :
     mutex_{},
     dev_{nullptr},
-    handler_{nullptr}
+    handler_{nullptr},
+    buffer_{},
+    buffer_length_{0}
 {
     std::unique_lock<std::mutex> our_lock{mutex_, std::defer_lock};
     std::unique_lock<std::mutex> other_lock{other.mutex_, std::defer_lock};
@@ -26,6 +30,8 @@ Device::Device(Device&& other) noexcept :
 
     dev_ = std::move(other.dev_);
     handler_ = std::move(other.handler_);
+    buffer_ = std::move(other.buffer_);
+    buffer_length_ = other.buffer_length_;
 
     other.dev_ = nullptr;
     other.handler_ = nullptr;
@@ -40,6 +46,8 @@ Device& Device::operator=(Device&& other) noexcept
 
     dev_ = std::move(other.dev_);
     handler_ = std::move(other.handler_);
+    buffer_ = std::move(other.buffer_);
+    buffer_length_ = other.buffer_length_;
 
     other.dev_ = nullptr;
     other.handler_ = nullptr;
@@ -50,7 +58,9 @@ Device& Device::operator=(Device&& other) noexcept
 Device::Device(unsigned int index) :
     mutex_{},
     dev_{nullptr},
-    handler_{nullptr}
+    handler_{nullptr},
+    buffer_{},
+    buffer_length_{0}
 {
     int result = rtlsdr_open(&dev_, index);
 
@@ -216,17 +226,35 @@ std::pair<bool, std::vector<float>> Device::listGains(void) noexcept
     return std::make_pair(true, out);
 }
 
-bool Device::readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept
+bool Device::setBufferLength(std::size_t bytes) noexcept
 {
     std::lock_guard<std::mutex> lock{mutex_};
 
-    if (! dev_) {
-        return false;
-    }
+    // librtlsdr wants a multiple of 512 bytes, 0 keeps its default
+    buffer_length_ = static_cast<std::uint32_t>((bytes + 511) / 512 * 512);
 
-    handler_ = handler;
+    return true;
+}
+
+bool Device::readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept
+{
+    rtlsdr_dev_t* dev = nullptr;
+    std::uint32_t buffer_length = 0;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! dev_) {
+            return false;
+        }
+
+        handler_ = handler;
+        dev = dev_;
+        buffer_length = buffer_length_;
+    }
 
-    int result = rtlsdr_read_async(dev_, &Device::callback, this, 0, 0);
+    // Not locked while streaming, so the device can be retuned from another thread
+    int result = rtlsdr_read_async(dev, &Device::callback, this, 0, buffer_length);
 
     if (result < 0) {
         std::cerr << result << std::endl;
@@ -259,6 +287,8 @@ void Device::callback(std::uint8_t* buf, std::uint32_t len, void* ctx)
     auto dev = reinterpret_cast<Device*>(ctx);
 
     if (dev->handler_) {
-        dev->handler_(std::vector<std::uint8_t>(buf, buf + len));
+        // Reuses the capacity of the previous transfer unless the handler took ownership of it
+        dev->buffer_.assign(buf, buf + len);
+        dev->handler_(std::move(dev->buffer_));
     }
 }
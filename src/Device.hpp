@@ -7,6 +7,7 @@
 #ifndef JDRADIO_DEVICE_HPP
 #define JDRADIO_DEVICE_HPP
 
+#include "SampleSource.hpp"
 #include <rtl-sdr.h>
 #include <vector>
 #include <string>
@@ -14,38 +15,10 @@
 #include <utility>
 #include <functional>
 #include <mutex>
-#include <exception>
 
-class Device
+class Device : public SampleSource
 {
 public:
-    struct Exception : std::exception
-    {
-        int code_;
-        char const* message_;
-
-        Exception(int code, char const* message) noexcept :
-            std::exception{},
-            code_{code},
-            message_{message}
-        {
-        }
-
-        virtual ~Exception(void) noexcept
-        {
-        }
-
-        char const* what(void) const noexcept override
-        {
-            return message_;
-        }
-
-        int code(void) const noexcept
-        {
-            return code_;
-        }
-    };
-
     struct OpenException : Exception
     {
         OpenException(int code) noexcept :
@@ -58,17 +31,18 @@ public:
     Device(Device&& other) noexcept;
     Device& operator=(Device&& other) noexcept;
     Device(unsigned int index);
-    ~Device(void) noexcept;
+    ~Device(void) noexcept override;
     static std::vector<std::tuple<unsigned int, std::string, std::string, std::string, std::string>> listDevices(void) noexcept;
-    bool setCenterFrequency(unsigned int freq) noexcept;
-    bool setSampleRate(unsigned int rate) noexcept;
+    bool setCenterFrequency(unsigned int freq) noexcept override;
+    bool setSampleRate(unsigned int rate) noexcept override;
     bool readSync(std::vector<std::uint8_t>& out) noexcept;
-    bool resetBuffer(void) noexcept;
-    bool setAgcMode(bool on) noexcept;
-    bool setGain(float gain) noexcept;
-    std::pair<bool, std::vector<float>> listGains(void) noexcept;
-    bool readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept;
-    bool cancelAsync(void) noexcept;
+    bool resetBuffer(void) noexcept override;
+    bool setAgcMode(bool on) noexcept override;
+    bool setGain(float gain) noexcept override;
+    std::pair<bool, std::vector<float>> listGains(void) noexcept override;
+    bool setBufferLength(std::size_t bytes) noexcept override;
+    bool readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept override;
+    bool cancelAsync(void) noexcept override;
 
 private:
     static void callback(std::uint8_t* buf, std::uint32_t len, void* ctx);
@@ -76,6 +50,8 @@ private:
     std::mutex mutex_;
     rtlsdr_dev_t* dev_;
     std::function<void(std::vector<std::uint8_t>&&)> handler_;
+    std::vector<std::uint8_t> buffer_;
+    std::uint32_t buffer_length_;
 };
 
 #endif
@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "DwellSequencer.hpp"
+#include <algorithm>
+#include <system_error>
+
+DwellSequencer::DwellSequencer(void) noexcept :
+    dwell_time_{100},
+    settle_time_{5},
+    sample_rate_{0},
+    apply_{nullptr},
+    state_{State::Changing},
+    settle_left_{0},
+    dwell_{},
+    dwell_size_{0},
+    worker_{},
+    mutex_{},
+    cv_{},
+    running_{false},
+    change_pending_{false},
+    change_value_{0.0},
+    changed_{false}
+{
+}
+
+DwellSequencer::~DwellSequencer(void) noexcept
+{
+    stop();
+}
+
+void DwellSequencer::setDwellTime(std::chrono::milliseconds dwell)
+{
+    dwell_time_ = dwell;
+}
+
+void DwellSequencer::setSettleTime(std::chrono::milliseconds settle)
+{
+    settle_time_ = settle;
+}
+
+bool DwellSequencer::start(unsigned int sample_rate, std::function<void(double)> apply)
+{
+    if (running_) {
+        return false;
+    }
+
+    sample_rate_ = sample_rate;
+    apply_ = apply;
+    dwell_size_ = static_cast<std::size_t>(sample_rate_ * dwell_time_.count() / 1000) * 2;
+    dwell_.reserve(dwell_size_);
+    changed_ = false;
+    change_pending_ = false;
+    state_ = State::Changing;
+    running_ = true;
+
+    try {
+        worker_ = std::thread{&DwellSequencer::changeLoop, this};
+    }
+    catch (std::system_error const&) {
+        running_ = false;
+        return false;
+    }
+
+    return true;
+}
+
+void DwellSequencer::stop(void) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    cv_.notify_one();
+
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void DwellSequencer::request(double value)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        changed_ = false;
+        change_pending_ = true;
+        change_value_ = value;
+    }
+
+    state_ = State::Changing;
+    cv_.notify_one();
+}
+
+void DwellSequencer::changeLoop(void)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        cv_.wait(lock, [this] { return change_pending_ || ! running_; });
+
+        if (! running_) {
+            break;
+        }
+
+        change_pending_ = false;
+        auto const value = change_value_;
+        lock.unlock();
+
+        apply_(value);
+
+        lock.lock();
+
+        // A newer request supersedes this one
+        if (! change_pending_) {
+            changed_ = true;
+        }
+    }
+}
+
+bool DwellSequencer::onSamples(std::vector<std::uint8_t> const& in)
+{
+    std::size_t offset = 0;
+    std::size_t const in_size = in.size() & ~static_cast<std::size_t>(1);
+
+    while (offset < in_size) {
+        switch (state_) {
+        case State::Changing:
+            if (! changed_) {
+                return false;
+            }
+
+            state_ = State::Flushing;
+            return false;
+
+        case State::Flushing:
+            // This buffer was being filled while the setting changed
+            state_ = State::Settling;
+            settle_left_ = static_cast<std::size_t>(sample_rate_ * settle_time_.count() / 1000) * 2;
+            return false;
+
+        case State::Settling: {
+            std::size_t const n = std::min(settle_left_, in_size - offset);
+            settle_left_ -= n;
+            offset += n;
+
+            if (settle_left_ == 0) {
+                state_ = State::Dwelling;
+                dwell_.clear();
+            }
+            break;
+        }
+
+        case State::Dwelling: {
+            std::size_t const n = std::min(dwell_size_ - dwell_.size(), in_size - offset);
+            dwell_.insert(std::end(dwell_), in.data() + offset, in.data() + offset + n);
+            offset += n;
+
+            if (dwell_.size() == dwell_size_) {
+                // Nothing more is collected until the next request
+                state_ = State::Changing;
+                changed_ = false;
+                return true;
+            }
+            break;
+        }
+        }
+    }
+
+    return false;
+}
+
+std::vector<std::uint8_t> const& DwellSequencer::dwell(void) const noexcept
+{
+    return dwell_;
+}
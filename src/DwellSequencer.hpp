@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_DWELLSEQUENCER_HPP
+#define JDRADIO_DWELLSEQUENCER_HPP
+
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+
+//! Applies a source setting, such as a frequency or a gain, then collects a
+//! dwell of samples once the source has settled.
+//!
+//! The setting is applied on a worker thread, so the stream is never blocked
+//! by the device. Once it is applied, the buffer that was being filled during
+//! the change is dropped and the settle time skipped, then the dwell is
+//! collected. Requesting the next setting as soon as a dwell is complete lets
+//! its analysis overlap with the change, since those samples are discarded.
+class DwellSequencer
+{
+public:
+    DwellSequencer(void) noexcept;
+    ~DwellSequencer(void) noexcept;
+
+    void setDwellTime(std::chrono::milliseconds dwell);
+    void setSettleTime(std::chrono::milliseconds settle);
+
+    //! apply() runs on the worker thread for each request
+    bool start(unsigned int sample_rate, std::function<void(double)> apply);
+    void stop(void) noexcept;
+    void request(double value);
+    //! Returns true when the buffer completed a dwell; the rest of it is dropped
+    bool onSamples(std::vector<std::uint8_t> const& in);
+    std::vector<std::uint8_t> const& dwell(void) const noexcept;
+
+private:
+    enum class State
+    {
+        Changing,
+        Flushing,
+        Settling,
+        Dwelling,
+    };
+
+    void changeLoop(void);
+
+    std::chrono::milliseconds dwell_time_;
+    std::chrono::milliseconds settle_time_;
+    unsigned int sample_rate_;
+    std::function<void(double)> apply_;
+    State state_;
+    std::size_t settle_left_;
+    std::vector<std::uint8_t> dwell_;
+    std::size_t dwell_size_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool running_;
+    bool change_pending_;
+    double change_value_;
+    std::atomic<bool> changed_;
+};
+
+#endif
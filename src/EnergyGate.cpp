@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "EnergyGate.hpp"
+#include <algorithm>
+#include <cmath>
+
+constexpr unsigned int EnergyGate::BAND_LENGTH;
+
+EnergyGate::EnergyGate(void) noexcept :
+    center_{127.5f},
+    threshold_{0.f},
+    block_length_{2048},
+    hangover_{1},
+    hold_{0},
+    floor_{-1.f},
+    open_buffers_{0},
+    closed_buffers_{0}
+{
+    // The narrow band leaves the noise floor steady enough for 3 dB, well under the detector's 10 dB
+    setThreshold(3.f);
+}
+
+void EnergyGate::setDCOffset(float offset) noexcept
+{
+    center_ = 127.5f + offset;
+}
+
+void EnergyGate::setThreshold(float db) noexcept
+{
+    threshold_ = std::pow(10.f, db / 10.f);
+}
+
+void EnergyGate::setBlockLength(unsigned int samples) noexcept
+{
+    // Whole band measurements only
+    block_length_ = std::min(std::max(samples, 64U), 16384U) / BAND_LENGTH * BAND_LENGTH;
+}
+
+void EnergyGate::setHangover(unsigned int buffers) noexcept
+{
+    hangover_ = buffers;
+}
+
+float EnergyGate::blockEnergy(std::uint8_t const* ptr, unsigned int samples) const noexcept
+{
+    float energy = 0.f;
+
+    for (unsigned int n = 0; n < samples; n += BAND_LENGTH) {
+        std::uint32_t sum_i = 0;
+        std::uint32_t sum_q = 0;
+
+        // Byte sums in integers, which the compiler vectorizes
+        for (unsigned int k = 0; k < BAND_LENGTH; ++k) {
+            sum_i += ptr[(n + k) * 2];
+            sum_q += ptr[(n + k) * 2 + 1];
+        }
+
+        // The run's mean is a boxcar low-pass, so only what is near DC remains;
+        // the DC offset would otherwise dominate it
+        float const i = static_cast<float>(sum_i) * (1.f / BAND_LENGTH) - center_;
+        float const q = static_cast<float>(sum_q) * (1.f / BAND_LENGTH) - center_;
+        energy += i*i + q*q;
+    }
+
+    return energy * BAND_LENGTH / samples;
+}
+
+bool EnergyGate::execute(std::vector<std::uint8_t> const& in) noexcept
+{
+    unsigned int const num_samples = in.size() / 2;
+    unsigned int num_blocks = 0;
+    float sum_energy = 0.f;
+    float max_energy = 0.f;
+
+    for (unsigned int n = 0; n + block_length_ <= num_samples; n += block_length_) {
+        float const energy = blockEnergy(in.data() + n * 2, block_length_);
+        sum_energy += energy;
+        max_energy = std::max(max_energy, energy);
+        ++num_blocks;
+    }
+
+    if (num_blocks == 0) {
+        // Buffer shorter than a block, nothing to decide on
+        ++open_buffers_;
+        return true;
+    }
+
+    // The floor follows the average block energy down immediately and up slowly,
+    // so a short transmission barely moves it
+    float const mean_energy = sum_energy / num_blocks;
+
+    if (floor_ < 0.f || mean_energy < floor_) {
+        floor_ = mean_energy;
+    }
+    else {
+        floor_ += 0.05f * (mean_energy - floor_);
+    }
+
+    if (max_energy >= floor_ * threshold_) {
+        hold_ = hangover_ + 1;
+    }
+
+    if (hold_ > 0) {
+        --hold_;
+        ++open_buffers_;
+        return true;
+    }
+
+    ++closed_buffers_;
+    return false;
+}
+
+float EnergyGate::noiseFloor(void) const noexcept
+{
+    return floor_;
+}
+
+std::uint64_t EnergyGate::openBuffers(void) const noexcept
+{
+    return open_buffers_;
+}
+
+std::uint64_t EnergyGate::closedBuffers(void) const noexcept
+{
+    return closed_buffers_;
+}
@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_ENERGYGATE_HPP
+#define JDRADIO_ENERGYGATE_HPP
+
+#include <vector>
+#include <cstdint>
+
+//! Decides from the raw cu8 samples whether a buffer is worth analyzing.
+//!
+//! The buffer is split in short blocks, and the energy of each block in a narrow
+//! band around DC, the detector's three center bins, is compared with an
+//! adaptive noise floor. The band comes from averaging runs of BAND_LENGTH
+//! samples with the dongle's DC offset removed, so neither the offset nor the
+//! rest of the spectrum hides a weak carrier. The gate opens when any block
+//! rises above the floor by the threshold, and stays open for a few buffers
+//! afterwards.
+class EnergyGate
+{
+public:
+    //! Samples averaged per band measurement, the first null falling two 32-point bins from DC
+    static constexpr unsigned int BAND_LENGTH = 16;
+
+    EnergyGate(void) noexcept;
+
+    //! Offset from 127.5 of the raw samples, as ARCAL measures it
+    void setDCOffset(float offset) noexcept;
+    void setThreshold(float db) noexcept;
+    void setBlockLength(unsigned int samples) noexcept;
+    void setHangover(unsigned int buffers) noexcept;
+    bool execute(std::vector<std::uint8_t> const& in) noexcept;
+    float noiseFloor(void) const noexcept;
+    std::uint64_t openBuffers(void) const noexcept;
+    std::uint64_t closedBuffers(void) const noexcept;
+
+private:
+    float blockEnergy(std::uint8_t const* ptr, unsigned int samples) const noexcept;
+
+    float center_;
+    float threshold_;
+    unsigned int block_length_;
+    unsigned int hangover_;
+    unsigned int hold_;
+    float floor_;
+    std::uint64_t open_buffers_;
+    std::uint64_t closed_buffers_;
+};
+
+#endif
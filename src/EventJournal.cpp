@@ -0,0 +1,258 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "EventJournal.hpp"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <system_error>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//! Records kept in memory between two writes
+static constexpr std::size_t BATCH_LENGTH = 4096;
+
+constexpr std::uint32_t EventJournal::MAGIC;
+constexpr std::uint16_t EventJournal::VERSION;
+constexpr std::size_t EventJournal::HEADER_SIZE;
+
+EventJournal::EventJournal(void) noexcept :
+    frequency_{0},
+    fd_{-1},
+    pending_{},
+    writing_{},
+    dropped_records_{0},
+    mutex_{},
+    cv_{},
+    writer_{},
+    running_{false}
+{
+}
+
+EventJournal::~EventJournal(void) noexcept
+{
+    close();
+}
+
+void EventJournal::setFrequency(unsigned int frequency) noexcept
+{
+    frequency_ = frequency;
+}
+
+bool EventJournal::open(std::string const& path)
+{
+    if (running_) {
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (fd_ < 0) {
+        std::cerr << fmt::format("Failed to open journal {}: {}", path, std::strerror(errno)) << std::endl;
+        return false;
+    }
+
+    struct stat st{};
+    ::fstat(fd_, &st);
+
+    std::uint8_t header[HEADER_SIZE] = {};
+
+    if (st.st_size == 0) {
+        std::uint16_t const record_size = sizeof(Record);
+        std::memcpy(header, &MAGIC, 4);
+        std::memcpy(header + 4, &VERSION, 2);
+        std::memcpy(header + 6, &record_size, 2);
+
+        if (::write(fd_, header, sizeof(header)) != sizeof(header)) {
+            std::cerr << fmt::format("Failed to write journal header: {}", std::strerror(errno)) << std::endl;
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+    }
+    else {
+        std::uint32_t magic = 0;
+        std::uint16_t version = 0;
+        std::uint16_t record_size = 0;
+        bool const complete = ::pread(fd_, header, sizeof(header), 0) == sizeof(header);
+        std::memcpy(&magic, header, 4);
+        std::memcpy(&version, header + 4, 2);
+        std::memcpy(&record_size, header + 6, 2);
+
+        // Appending records of another layout would make the whole file unreadable
+        if (! complete || magic != MAGIC || version != VERSION || record_size != sizeof(Record)) {
+            std::cerr << fmt::format("{} is not a version {} ARCAL journal", path, VERSION) << std::endl;
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        // A crash in the middle of a write leaves a partial record at the end
+        auto const torn = (st.st_size - HEADER_SIZE) % sizeof(Record);
+
+        if (torn != 0) {
+            ::ftruncate(fd_, st.st_size - torn);
+        }
+    }
+
+    pending_.clear();
+    writing_.clear();
+    pending_.reserve(BATCH_LENGTH);
+    writing_.reserve(BATCH_LENGTH);
+    dropped_records_ = 0;
+    running_ = true;
+
+    try {
+        writer_ = std::thread{&EventJournal::writerLoop, this};
+    }
+    catch (std::system_error const&) {
+        running_ = false;
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void EventJournal::close(void) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    cv_.notify_one();
+
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void EventJournal::append(Event event, std::uint32_t duration_us, std::uint64_t value) noexcept
+{
+    append(event, std::chrono::system_clock::now(), duration_us, value);
+}
+
+void EventJournal::append(Event event, std::chrono::system_clock::time_point time, std::uint32_t duration_us, std::uint64_t value) noexcept
+{
+    auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    Record const record{static_cast<std::uint64_t>(ns), static_cast<std::uint16_t>(event), 0, duration_us, frequency_, value};
+    bool flush = false;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        if (pending_.size() == pending_.capacity()) {
+            ++dropped_records_;
+            return;
+        }
+
+        pending_.push_back(record);
+        // Wake the writer early when the batch is filling up
+        flush = pending_.size() >= BATCH_LENGTH / 2;
+    }
+
+    if (flush) {
+        cv_.notify_one();
+    }
+}
+
+std::uint64_t EventJournal::droppedRecords(void) const noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return dropped_records_;
+}
+
+char const* EventJournal::eventName(Event event) noexcept
+{
+    switch (event) {
+    case Event::SignalOn: return "signal_on";
+    case Event::SignalOff: return "signal_off";
+    case Event::Click: return "click";
+    case Event::Activation: return "activation";
+    case Event::Drop: return "drop";
+    }
+
+    return "unknown";
+}
+
+void EventJournal::writerLoop(void)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        cv_.wait_for(lock, std::chrono::seconds(1), [this] { return pending_.size() >= BATCH_LENGTH / 2 || ! running_; });
+
+        bool const stopping = ! running_;
+
+        // Both batches have the same capacity, so swapping never allocates
+        std::swap(pending_, writing_);
+        lock.unlock();
+
+        if (! writing_.empty()) {
+            auto const* data = reinterpret_cast<std::uint8_t const*>(writing_.data());
+            std::size_t const size = writing_.size() * sizeof(Record);
+            std::size_t written = 0;
+
+            while (written < size) {
+                ssize_t result = ::write(fd_, data + written, size - written);
+
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    std::cerr << fmt::format("Failed to write journal: {}", std::strerror(errno)) << std::endl;
+                    break;
+                }
+
+                written += result;
+            }
+
+            if (written < size) {
+                // Cut a partial record, or every record appended after it would be misaligned
+                struct stat st{};
+
+                if (::fstat(fd_, &st) == 0) {
+                    auto const torn = (st.st_size - HEADER_SIZE) % sizeof(Record);
+
+                    if (torn != 0 && ::ftruncate(fd_, st.st_size - torn) < 0) {
+                        std::cerr << fmt::format("Failed to truncate journal: {}", std::strerror(errno)) << std::endl;
+                    }
+                }
+
+                lock.lock();
+                dropped_records_ += (size - written) / sizeof(Record) + ((size - written) % sizeof(Record) != 0 ? 1 : 0);
+                lock.unlock();
+            }
+
+            // An audit trail is only worth something if it survives a power cut
+            ::fdatasync(fd_);
+            writing_.clear();
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_EVENTJOURNAL_HPP
+#define JDRADIO_EVENTJOURNAL_HPP
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//! Append-only audit trail of detection events.
+//!
+//! The file is a 16-byte header followed by fixed 32-byte records in host
+//! byte order, so a reader can mmap it and index records directly:
+//!
+//!     header: uint32 magic 'ARJL', uint16 version 1, uint16 record size,
+//!             uint64 reserved
+//!     record: uint64 time      nanoseconds since the UNIX epoch
+//!             uint16 type      EventJournal::Event
+//!             uint16 reserved
+//!             uint32 duration  microseconds, signal off and clicks
+//!             uint64 frequency Hz
+//!             uint64 value     samples for drops, otherwise 0
+//!
+//! append() only copies the record into a preallocated batch. A writer thread
+//! writes the batch and syncs it to disk at least once a second. A torn
+//! record left by a crash is cut off when the journal is reopened.
+class EventJournal
+{
+public:
+    enum class Event : std::uint16_t
+    {
+        SignalOn = 1,
+        SignalOff = 2,
+        Click = 3,
+        Activation = 4,
+        Drop = 5,
+    };
+
+    struct Record
+    {
+        std::uint64_t time_;
+        std::uint16_t type_;
+        std::uint16_t reserved_;
+        std::uint32_t duration_;
+        std::uint64_t frequency_;
+        std::uint64_t value_;
+    };
+
+    static constexpr std::uint32_t MAGIC = 0x4c4a5241; // "ARJL"
+    static constexpr std::uint16_t VERSION = 1;
+    static constexpr std::size_t HEADER_SIZE = 16;
+
+    EventJournal(void) noexcept;
+    ~EventJournal(void) noexcept;
+
+    void setFrequency(unsigned int frequency) noexcept;
+    bool open(std::string const& path);
+    void close(void) noexcept;
+    void append(Event event, std::uint32_t duration_us = 0, std::uint64_t value = 0) noexcept;
+    void append(Event event, std::chrono::system_clock::time_point time, std::uint32_t duration_us, std::uint64_t value) noexcept;
+    std::uint64_t droppedRecords(void) const noexcept;
+
+    static char const* eventName(Event event) noexcept;
+
+private:
+    void writerLoop(void);
+
+    unsigned int frequency_;
+    int fd_;
+    std::vector<Record> pending_;
+    std::vector<Record> writing_;
+    std::uint64_t dropped_records_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread writer_;
+    bool running_;
+};
+
+static_assert(sizeof(EventJournal::Record) == 32, "journal records must stay 32 bytes");
+
+#endif
@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "EventLoop.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <csignal>
+#include <fmt/format.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+EventLoop::EventLoop(void) noexcept :
+    epoll_fd_{::epoll_create1(EPOLL_CLOEXEC)},
+    wake_fd_{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+    running_{false},
+    handlers_{},
+    owned_fds_{}
+{
+}
+
+EventLoop::~EventLoop(void) noexcept
+{
+    for (auto fd : owned_fds_) {
+        ::close(fd);
+    }
+
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+bool EventLoop::add(int fd, std::function<void(void)> handler)
+{
+    if (epoll_fd_ < 0 || fd < 0) {
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::cerr << fmt::format("Failed to watch fd {}: {}", fd, std::strerror(errno)) << std::endl;
+        return false;
+    }
+
+    handlers_[fd] = handler;
+
+    return true;
+}
+
+void EventLoop::remove(int fd) noexcept
+{
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    handlers_.erase(fd);
+}
+
+int EventLoop::addTimer(std::function<void(void)> handler)
+{
+    int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    bool const ok = add(fd, [fd, handler] {
+        std::uint64_t expirations = 0;
+
+        if (::read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            handler();
+        }
+    });
+
+    if (! ok) {
+        ::close(fd);
+        return -1;
+    }
+
+    owned_fds_.push_back(fd);
+
+    return fd;
+}
+
+bool EventLoop::armTimer(int timer, std::chrono::nanoseconds delay, std::chrono::nanoseconds interval) noexcept
+{
+    // A zero delay would disarm the timer, fire as soon as possible instead
+    delay = std::max(delay, std::chrono::nanoseconds{1});
+
+    itimerspec spec{};
+    spec.it_value.tv_sec = delay.count() / 1'000'000'000;
+    spec.it_value.tv_nsec = delay.count() % 1'000'000'000;
+    spec.it_interval.tv_sec = interval.count() / 1'000'000'000;
+    spec.it_interval.tv_nsec = interval.count() % 1'000'000'000;
+
+    return ::timerfd_settime(timer, 0, &spec, nullptr) == 0;
+}
+
+bool EventLoop::disarmTimer(int timer) noexcept
+{
+    itimerspec spec{};
+    return ::timerfd_settime(timer, 0, &spec, nullptr) == 0;
+}
+
+bool EventLoop::blockSignals(std::initializer_list<int> signals) noexcept
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+
+    for (auto sig : signals) {
+        sigaddset(&mask, sig);
+    }
+
+    return ::pthread_sigmask(SIG_BLOCK, &mask, nullptr) == 0;
+}
+
+bool EventLoop::addSignals(std::initializer_list<int> signals, std::function<void(int)> handler)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+
+    for (auto sig : signals) {
+        sigaddset(&mask, sig);
+    }
+
+    // The signals must already be blocked in every thread, see blockSignals()
+    int fd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    bool const ok = add(fd, [fd, handler] {
+        signalfd_siginfo info{};
+
+        while (::read(fd, &info, sizeof(info)) == sizeof(info)) {
+            handler(static_cast<int>(info.ssi_signo));
+        }
+    });
+
+    if (! ok) {
+        ::close(fd);
+        return false;
+    }
+
+    owned_fds_.push_back(fd);
+
+    return true;
+}
+
+bool EventLoop::run(void)
+{
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        std::cerr << "Failed to create event loop" << std::endl;
+        return false;
+    }
+
+    if (! add(wake_fd_, [this] {
+        std::uint64_t count = 0;
+
+        if (::read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            std::cerr << fmt::format("Failed to clear event loop wakeup: {}", std::strerror(errno)) << std::endl;
+        }
+
+        running_ = false;
+    })) {
+        return false;
+    }
+
+    running_ = true;
+
+    epoll_event events[16];
+
+    while (running_) {
+        int count = ::epoll_wait(epoll_fd_, events, 16, -1);
+
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            std::cerr << fmt::format("Event loop failed: {}", std::strerror(errno)) << std::endl;
+            break;
+        }
+
+        for (int n = 0; n < count; ++n) {
+            // A handler may have removed another fd of this batch
+            auto it = handlers_.find(events[n].data.fd);
+
+            if (it != std::end(handlers_)) {
+                auto handler = it->second;
+                handler();
+            }
+        }
+    }
+
+    remove(wake_fd_);
+
+    return true;
+}
+
+void EventLoop::stop(void) noexcept
+{
+    std::uint64_t one = 1;
+
+    // EAGAIN means the counter is saturated, so a wakeup is already pending
+    if (::write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        std::cerr << fmt::format("Failed to stop event loop: {}", std::strerror(errno)) << std::endl;
+    }
+}
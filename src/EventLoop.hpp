@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_EVENTLOOP_HPP
+#define JDRADIO_EVENTLOOP_HPP
+
+#include <map>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+
+//! epoll based event loop with timerfd timers and signalfd signals.
+//!
+//! Handlers run on the thread that called run(). armTimer() and stop() may be
+//! called from any thread; everything else belongs to the loop thread.
+class EventLoop
+{
+public:
+    EventLoop(void) noexcept;
+    ~EventLoop(void) noexcept;
+
+    bool add(int fd, std::function<void(void)> handler);
+    void remove(int fd) noexcept;
+    int addTimer(std::function<void(void)> handler);
+    bool armTimer(int timer, std::chrono::nanoseconds delay, std::chrono::nanoseconds interval = std::chrono::nanoseconds{0}) noexcept;
+    bool disarmTimer(int timer) noexcept;
+    bool addSignals(std::initializer_list<int> signals, std::function<void(int)> handler);
+    bool run(void);
+    void stop(void) noexcept;
+
+    static bool blockSignals(std::initializer_list<int> signals) noexcept;
+
+private:
+    int epoll_fd_;
+    int wake_fd_;
+    bool running_;
+    std::map<int, std::function<void(void)>> handlers_;
+    std::vector<int> owned_fds_;
+};
+
+#endif
@@ -5,10 +5,33 @@
 //! \copyright JDRadio Inc.
 ////////////////////////////////////////////////////////////////////////////////
 #include "FFT.hpp"
+#include "FixedFFT.hpp"
+#include "CacheDirectory.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fmt/format.h>
+
+//! Below this length, waking the other threads costs more than the transform
+static constexpr unsigned int THREADED_LENGTH = 8192;
+
+unsigned int FFT::planner_flags_ = FFTW_MEASURE;
+unsigned int FFT::threads_ = 1;
+std::mutex FFT::planner_mutex_;
 
 FFT::FFT(void) :
     head_{0},
     length_{0},
+    window_{Window::Rectangular},
+    overlap_{0.f},
+    hop_{0},
+    noise_bandwidth_{1.f},
+    remaining_{0},
+    history_{},
+    coefficients_{},
+    kernel_{nullptr},
     plan_{nullptr},
     input_buffer_{nullptr},
     output_buffer_{nullptr}
@@ -19,6 +42,7 @@ FFT::FFT(void) :
 FFT::~FFT(void)
 {
     if (plan_) {
+        std::lock_guard<std::mutex> lock{planner_mutex_};
         fftwf_destroy_plan(plan_);
     }
 
@@ -33,8 +57,11 @@ FFT::~FFT(void)
 
 void FFT::setLength(unsigned int len)
 {
+    std::lock_guard<std::mutex> lock{planner_mutex_};
+
     if (plan_) {
         fftwf_destroy_plan(plan_);
+        plan_ = nullptr;
     }
 
     if (input_buffer_) {
@@ -47,36 +74,246 @@ void FFT::setLength(unsigned int len)
 
     head_ = 0;
     length_ = len;
+    history_.assign(len * 2, 0.f);
     input_buffer_ = fftwf_alloc_complex(len);
     output_buffer_ = fftwf_alloc_complex(len);
-    plan_ = fftwf_plan_dft_1d(len, input_buffer_, output_buffer_, FFTW_FORWARD, FFTW_MEASURE | FFTW_DESTROY_INPUT);
+
+    // Small sizes are dominated by FFTW's dispatch overhead, use the unrolled kernels instead.
+    // From 128 points up, FFTW's SIMD codelets are faster than the scalar kernels.
+    switch (len) {
+    case 16: kernel_ = &FixedFFT<16>::execute; break;
+    case 32: kernel_ = &FixedFFT<32>::execute; break;
+    case 64: kernel_ = &FixedFFT<64>::execute; break;
+    default: kernel_ = nullptr; break;
+    }
+
+    if (! kernel_) {
+        // The thread count is planner state, it applies to every plan made after it is set
+        if (threads_ > 1) {
+            fftwf_plan_with_nthreads(len >= THREADED_LENGTH ? threads_ : 1);
+        }
+
+        plan_ = fftwf_plan_dft_1d(len, input_buffer_, output_buffer_, FFTW_FORWARD, planner_flags_ | FFTW_DESTROY_INPUT);
+    }
+
+    updateCoefficients();
+}
+
+void FFT::setWindow(Window window)
+{
+    window_ = window;
+    updateCoefficients();
+}
+
+void FFT::setOverlap(float ratio)
+{
+    overlap_ = std::min(std::max(ratio, 0.f), 0.99f);
+    updateCoefficients();
+}
+
+void FFT::updateCoefficients(void)
+{
+    double const pi = std::acos(-1.0);
+    std::vector<double> window(length_);
+    double sum = 0.0;
+    double sum_squares = 0.0;
+
+    for (unsigned int n = 0; n < length_; ++n) {
+        // Periodic windows, since the frames are analyzed rather than filtered
+        double const x = 2.0 * pi * n / length_;
+
+        switch (window_) {
+        case Window::Rectangular:
+            window[n] = 1.0;
+            break;
+        case Window::Hann:
+            window[n] = 0.5 - 0.5 * std::cos(x);
+            break;
+        case Window::BlackmanHarris:
+            window[n] = 0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2 * x) - 0.01168 * std::cos(3 * x);
+            break;
+        case Window::FlatTop:
+            window[n] = 0.21557895 - 0.41663158 * std::cos(x) + 0.277263158 * std::cos(2 * x) - 0.083578947 * std::cos(3 * x) + 0.006947368 * std::cos(4 * x);
+            break;
+        }
+
+        sum += window[n];
+        sum_squares += window[n] * window[n];
+    }
+
+    // With the coefficients normalized by the sum, noise power per bin grows by this much
+    noise_bandwidth_ = static_cast<float>(length_ * sum_squares / (sum * sum));
+
+    // Window, fftshift and normalization all folded into a single multiply.
+    // Normalizing by the window sum keeps a tone at the same level whatever the window.
+    coefficients_.resize(length_);
+    for (unsigned int n = 0; n < length_; ++n) {
+        coefficients_[n] = static_cast<float>(window[n] / sum) * (n % 2 ? 1.f : -1.f);
+    }
+
+    hop_ = std::max(1U, static_cast<unsigned int>(std::lround(length_ * (1.0 - overlap_))));
+    // The first frame needs a full history
+    remaining_ = length_;
+    head_ = 0;
+}
+
+void FFT::transform(std::vector<float>& out)
+{
+    // head_ points to the oldest sample of the history
+    unsigned int const first = length_ - head_;
+    float const* hist = history_.data();
+    float const* coef = coefficients_.data();
+
+    for (unsigned int m = 0; m < first; ++m) {
+        input_buffer_[m][0] = hist[(head_+m)*2] * coef[m];
+        input_buffer_[m][1] = hist[(head_+m)*2+1] * coef[m];
+    }
+
+    for (unsigned int m = first; m < length_; ++m) {
+        input_buffer_[m][0] = hist[(m-first)*2] * coef[m];
+        input_buffer_[m][1] = hist[(m-first)*2+1] * coef[m];
+    }
+
+    if (kernel_) {
+        kernel_(input_buffer_, output_buffer_);
+    }
+    else {
+        fftwf_execute(plan_);
+    }
+
+    for (unsigned int n = 0; n < length_; ++n) {
+        out.push_back(output_buffer_[n][0]);
+        out.push_back(output_buffer_[n][1]);
+    }
 }
 
-std::vector<float> FFT::execute(std::vector<float> const& in)
+void FFT::execute(std::vector<float> const& in, std::vector<float>& out)
 {
     unsigned int const in_size = in.size();
-    std::vector<float> out;
-    out.reserve((in_size / length_ + 1) * length_);
+    // Only grows the caller's buffer the first time a given input size is seen
+    out.clear();
+    out.reserve((in_size / 2 / hop_ + 1) * length_ * 2);
 
     for (unsigned int i = 0; i < in_size; i += 2) {
-        input_buffer_[head_][0] = in[i] * (i % 4 ? 1 : -1);
-        input_buffer_[head_][1] = in[i+1] * (i % 4 ? 1 : -1);
+        history_[head_*2] = in[i];
+        history_[head_*2+1] = in[i+1];
 
         if (++head_ == length_) {
             head_ = 0;
-            fftwf_execute(plan_);
+        }
 
-            for (unsigned int n = 0; n < length_; ++n) {
-                out.push_back(output_buffer_[n][0] / length_);
-                out.push_back(output_buffer_[n][1] / length_);
-            }
+        if (--remaining_ == 0) {
+            remaining_ = hop_;
+            transform(out);
         }
     }
+}
+
+unsigned int FFT::skip(unsigned int samples) noexcept
+{
+    // Number of frames execute() would have produced for these samples
+    unsigned int const frames = samples >= remaining_ ? 1 + (samples - remaining_) / hop_ : 0;
+
+    // The history now has a gap, so the next frame waits for a full refill
+    remaining_ = length_;
+    head_ = 0;
 
-    return out;
+    return frames;
 }
 
 unsigned int FFT::length(void) const noexcept
 {
     return length_;
 }
+
+unsigned int FFT::hop(void) const noexcept
+{
+    return hop_;
+}
+
+float FFT::noiseBandwidth(void) const noexcept
+{
+    return noise_bandwidth_;
+}
+
+void FFT::setPlannerEffort(Effort effort) noexcept
+{
+    switch (effort) {
+    case Effort::Estimate:
+        planner_flags_ = FFTW_ESTIMATE;
+        break;
+    case Effort::Measure:
+        planner_flags_ = FFTW_MEASURE;
+        break;
+    case Effort::Patient:
+        planner_flags_ = FFTW_PATIENT;
+        break;
+    }
+}
+
+void FFT::setThreads(unsigned int threads)
+{
+    static bool initialized = false;
+    std::lock_guard<std::mutex> lock{planner_mutex_};
+
+    // FFTW wants its threads initialized before any other call, main() does this first
+    if (threads > 1 && ! initialized) {
+        fftwf_init_threads();
+        initialized = true;
+    }
+
+    if (initialized) {
+        fftwf_plan_with_nthreads(1);
+    }
+
+    threads_ = std::max(threads, 1U);
+}
+
+unsigned int FFT::threads(void) noexcept
+{
+    return threads_;
+}
+
+std::string FFT::defaultWisdomPath(void)
+{
+    // Wisdom is only valid for the CPU and FFTW build that produced it, so both are in the name
+    std::string cpu;
+    std::ifstream cpuinfo{"/proc/cpuinfo"};
+    std::string line;
+
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0 || line.compare(0, 8, "CPU part") == 0 || line.compare(0, 8, "Hardware") == 0) {
+            cpu += line;
+        }
+    }
+
+    // FNV-1a, stable across builds unlike std::hash
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : cpu) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+
+    return fmt::format("{}/fftwf-wisdom-{:016x}-{}.txt", CacheDirectory::path(), hash, fftwf_version);
+}
+
+bool FFT::importWisdom(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock{planner_mutex_};
+    return fftwf_import_wisdom_from_filename(path.c_str()) != 0;
+}
+
+bool FFT::exportWisdom(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock{planner_mutex_};
+    return fftwf_export_wisdom_to_filename(path.c_str()) != 0;
+}
+
+void FFT::prePlan(std::vector<unsigned int> const& lengths)
+{
+    FFT fft{};
+
+    for (auto len : lengths) {
+        std::cout << fmt::format("Planning {}-point FFT", len) << std::endl;
+        fft.setLength(len);
+    }
+}
@@ -8,23 +8,71 @@
 #define JDRADIO_FFT_HPP
 
 #include <vector>
+#include <string>
+#include <mutex>
 #include <fftw3.h>
 
 class FFT
 {
 public:
+    enum class Window
+    {
+        Rectangular,
+        Hann,
+        BlackmanHarris,
+        FlatTop,
+    };
+
+    enum class Effort
+    {
+        Estimate,
+        Measure,
+        Patient,
+    };
+
     FFT(void);
     ~FFT(void);
     void setLength(unsigned int len);
-    std::vector<float> execute(std::vector<float> const& in);
+    void setWindow(Window window);
+    void setOverlap(float ratio);
+    void execute(std::vector<float> const& in, std::vector<float>& out);
+    unsigned int skip(unsigned int samples) noexcept;
     unsigned int length(void) const noexcept;
+    unsigned int hop(void) const noexcept;
+    //! Equivalent noise bandwidth of the window in bins, 1 for rectangular and 1.5 for Hann
+    float noiseBandwidth(void) const noexcept;
+
+    static void setPlannerEffort(Effort effort) noexcept;
+    //! Threads used by large transforms; set it before the first FFT is created
+    static void setThreads(unsigned int threads);
+    static unsigned int threads(void) noexcept;
+    static std::string defaultWisdomPath(void);
+    static bool importWisdom(std::string const& path);
+    static bool exportWisdom(std::string const& path);
+    static void prePlan(std::vector<unsigned int> const& lengths);
 
 private:
+    void updateCoefficients(void);
+    void transform(std::vector<float>& out);
+
     unsigned int head_;
     unsigned int length_;
+    Window window_;
+    float overlap_;
+    unsigned int hop_;
+    float noise_bandwidth_;
+    unsigned int remaining_;
+    std::vector<float> history_;
+    std::vector<float> coefficients_;
+    void (*kernel_)(fftwf_complex* in, fftwf_complex* out);
     fftwf_plan plan_;
     fftwf_complex* input_buffer_;
     fftwf_complex* output_buffer_;
+
+    static unsigned int planner_flags_;
+    static unsigned int threads_;
+    //! FFTW's planner is not thread-safe, only fftwf_execute is
+    static std::mutex planner_mutex_;
 };
 
 #endif
@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_FIXEDFFT_HPP
+#define JDRADIO_FIXEDFFT_HPP
+
+#include <fftw3.h>
+
+//! Forward DFT of a compile-time power-of-two size.
+//!
+//! Recursive radix-4 decimation in time with a radix-2 stage when the size is
+//! not a power of four. Every size and stride is a template parameter, so the
+//! compiler sees constant trip counts and unrolls the butterflies, and the
+//! twiddles are constexpr tables. Same layout and sign as an FFTW forward plan,
+//! unnormalized.
+template<unsigned int N>
+class FixedFFT
+{
+public:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "FixedFFT size must be a power of two");
+
+    static void execute(fftwf_complex* in, fftwf_complex* out) noexcept;
+};
+
+namespace fixed_fft_detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+//! Taylor series, since std::sin and std::cos are not constexpr in C++14
+constexpr double sine(double x)
+{
+    while (x > PI) {
+        x -= 2 * PI;
+    }
+
+    while (x < -PI) {
+        x += 2 * PI;
+    }
+
+    double term = x;
+    double sum = x;
+
+    for (int n = 1; n < 20; ++n) {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+constexpr double cosine(double x)
+{
+    return sine(x + PI / 2);
+}
+
+//! W_N^k = exp(-2 pi j k / N) for k < 3N/4, enough for every radix-4 butterfly
+template<unsigned int N>
+struct Twiddles
+{
+    constexpr Twiddles(void) :
+        re_{},
+        im_{}
+    {
+        for (unsigned int k = 0; k < N; ++k) {
+            re_[k] = static_cast<float>(cosine(-2 * PI * k / N));
+            im_[k] = static_cast<float>(sine(-2 * PI * k / N));
+        }
+    }
+
+    float re_[N];
+    float im_[N];
+};
+
+template<unsigned int N>
+struct Table
+{
+    static constexpr Twiddles<N> value{};
+};
+
+template<unsigned int N>
+constexpr Twiddles<N> Table<N>::value;
+
+//! DFT of N inputs taken every S complex samples, written contiguously
+template<unsigned int N, unsigned int S>
+struct Kernel
+{
+    static void run(float const* in, float* out) noexcept
+    {
+        constexpr unsigned int M = N / 4;
+        constexpr auto const& w = Table<N>::value;
+
+        Kernel<M, S * 4>::run(in, out);
+        Kernel<M, S * 4>::run(in + S * 2, out + M * 2);
+        Kernel<M, S * 4>::run(in + S * 4, out + M * 4);
+        Kernel<M, S * 4>::run(in + S * 6, out + M * 6);
+
+        for (unsigned int q = 0; q < M; ++q) {
+            float* x0 = out + q * 2;
+            float* x1 = out + (q + M) * 2;
+            float* x2 = out + (q + M * 2) * 2;
+            float* x3 = out + (q + M * 3) * 2;
+
+            // a_r = W_N^(r q) F_r[q]
+            float const a0r = x0[0];
+            float const a0i = x0[1];
+            float const a1r = x1[0] * w.re_[q] - x1[1] * w.im_[q];
+            float const a1i = x1[0] * w.im_[q] + x1[1] * w.re_[q];
+            float const a2r = x2[0] * w.re_[q * 2] - x2[1] * w.im_[q * 2];
+            float const a2i = x2[0] * w.im_[q * 2] + x2[1] * w.re_[q * 2];
+            float const a3r = x3[0] * w.re_[q * 3] - x3[1] * w.im_[q * 3];
+            float const a3i = x3[0] * w.im_[q * 3] + x3[1] * w.re_[q * 3];
+
+            float const s02r = a0r + a2r;
+            float const s02i = a0i + a2i;
+            float const d02r = a0r - a2r;
+            float const d02i = a0i - a2i;
+            float const s13r = a1r + a3r;
+            float const s13i = a1i + a3i;
+            float const d13r = a1r - a3r;
+            float const d13i = a1i - a3i;
+
+            x0[0] = s02r + s13r;
+            x0[1] = s02i + s13i;
+            // -j (a1 - a3)
+            x1[0] = d02r + d13i;
+            x1[1] = d02i - d13r;
+            x2[0] = s02r - s13r;
+            x2[1] = s02i - s13i;
+            // +j (a1 - a3)
+            x3[0] = d02r - d13i;
+            x3[1] = d02i + d13r;
+        }
+    }
+};
+
+template<unsigned int S>
+struct Kernel<4, S>
+{
+    static void run(float const* in, float* out) noexcept
+    {
+        float const a0r = in[0];
+        float const a0i = in[1];
+        float const a1r = in[S * 2];
+        float const a1i = in[S * 2 + 1];
+        float const a2r = in[S * 4];
+        float const a2i = in[S * 4 + 1];
+        float const a3r = in[S * 6];
+        float const a3i = in[S * 6 + 1];
+
+        out[0] = a0r + a1r + a2r + a3r;
+        out[1] = a0i + a1i + a2i + a3i;
+        out[2] = a0r + a1i - a2r - a3i;
+        out[3] = a0i - a1r - a2i + a3r;
+        out[4] = a0r - a1r + a2r - a3r;
+        out[5] = a0i - a1i + a2i - a3i;
+        out[6] = a0r - a1i - a2r + a3i;
+        out[7] = a0i + a1r - a2i - a3r;
+    }
+};
+
+template<unsigned int S>
+struct Kernel<2, S>
+{
+    static void run(float const* in, float* out) noexcept
+    {
+        out[0] = in[0] + in[S * 2];
+        out[1] = in[1] + in[S * 2 + 1];
+        out[2] = in[0] - in[S * 2];
+        out[3] = in[1] - in[S * 2 + 1];
+    }
+};
+
+}
+
+template<unsigned int N>
+void FixedFFT<N>::execute(fftwf_complex* in, fftwf_complex* out) noexcept
+{
+    fixed_fft_detail::Kernel<N, 1>::run(&in[0][0], &out[0][0]);
+}
+
+#endif
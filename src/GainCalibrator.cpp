@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "GainCalibrator.hpp"
+#include "CacheDirectory.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fmt/format.h>
+
+GainCalibrator::GainCalibrator(void) noexcept :
+    dwell_time_{50},
+    settle_time_{10},
+    fft_length_{256},
+    clip_limit_{0.001f},
+    source_{nullptr},
+    sample_rate_{0},
+    gains_{},
+    snr_db_{},
+    clipped_{},
+    fft_{},
+    sequencer_{},
+    current_{0},
+    finishing_{false},
+    done_{false},
+    best_gain_{0.f},
+    samples_{},
+    spectrum_{},
+    bin_power_{},
+    running_{false}
+{
+}
+
+GainCalibrator::~GainCalibrator(void) noexcept
+{
+    stop();
+}
+
+void GainCalibrator::setDwellTime(std::chrono::milliseconds dwell)
+{
+    dwell_time_ = dwell;
+}
+
+void GainCalibrator::setSettleTime(std::chrono::milliseconds settle)
+{
+    settle_time_ = settle;
+}
+
+void GainCalibrator::setFFTLength(unsigned int len)
+{
+    fft_length_ = len;
+}
+
+void GainCalibrator::setClipLimit(float ratio)
+{
+    clip_limit_ = ratio;
+}
+
+bool GainCalibrator::start(SampleSource& source, std::vector<float> const& gains, unsigned int sample_rate)
+{
+    if (running_ || gains.empty()) {
+        return false;
+    }
+
+    source_ = &source;
+    sample_rate_ = sample_rate;
+    gains_ = gains;
+    std::sort(std::begin(gains_), std::end(gains_));
+    snr_db_.assign(gains_.size(), 0.f);
+    clipped_.assign(gains_.size(), false);
+
+    fft_.setLength(fft_length_);
+    fft_.setWindow(FFT::Window::Hann);
+    bin_power_.resize(fft_length_);
+
+    samples_.resize(static_cast<std::size_t>(sample_rate_ * dwell_time_.count() / 1000) * 2);
+
+    current_ = 0;
+    finishing_ = false;
+    done_ = false;
+
+    sequencer_.setDwellTime(dwell_time_);
+    sequencer_.setSettleTime(settle_time_);
+
+    bool const started = sequencer_.start(sample_rate_, [this] (double gain) {
+        if (! source_->setGain(static_cast<float>(gain))) {
+            std::cerr << fmt::format("Failed to set gain {:.1f} dB", gain) << std::endl;
+        }
+    });
+
+    if (! started) {
+        return false;
+    }
+
+    running_ = true;
+    sequencer_.request(gains_[current_]);
+
+    return true;
+}
+
+void GainCalibrator::stop(void) noexcept
+{
+    sequencer_.stop();
+    running_ = false;
+}
+
+float GainCalibrator::bestGain(void) const noexcept
+{
+    return best_gain_;
+}
+
+bool GainCalibrator::onSamples(std::vector<std::uint8_t> const& in)
+{
+    if (done_) {
+        return true;
+    }
+
+    if (! running_ || ! sequencer_.onSamples(in)) {
+        return false;
+    }
+
+    if (finishing_) {
+        // The best gain is applied and has settled, the stream can take over
+        done_ = true;
+        stop();
+        return true;
+    }
+
+    unsigned int const measured = current_++;
+
+    if (current_ < gains_.size()) {
+        // Change the gain first so the measurement overlaps with the settling time
+        sequencer_.request(gains_[current_]);
+        measureDwell(measured, sequencer_.dwell());
+    }
+    else {
+        measureDwell(measured, sequencer_.dwell());
+        selectBest();
+        finishing_ = true;
+        sequencer_.request(best_gain_);
+    }
+
+    return false;
+}
+
+void GainCalibrator::measureDwell(unsigned int index, std::vector<std::uint8_t> const& dwell)
+{
+    std::size_t const size = dwell.size();
+    std::size_t clipped = 0;
+    std::uint64_t sum_i = 0;
+    std::uint64_t sum_q = 0;
+
+    for (std::size_t n = 0; n < size; n += 2) {
+        clipped += (dwell[n] == 0 || dwell[n] == 255) ? 1 : 0;
+        clipped += (dwell[n+1] == 0 || dwell[n+1] == 255) ? 1 : 0;
+        sum_i += dwell[n];
+        sum_q += dwell[n+1];
+    }
+
+    // The dongle's DC offset would otherwise be the strongest bin at low gains and
+    // pass for the reference; only a signal within a few Hz of the tuned frequency
+    // goes with it
+    float const offset_i = static_cast<float>(sum_i) / (size / 2);
+    float const offset_q = static_cast<float>(sum_q) / (size / 2);
+
+    for (std::size_t n = 0; n < size; n += 2) {
+        samples_[n] = (static_cast<float>(dwell[n]) - offset_i) * (1.f / 128.f);
+        samples_[n+1] = (static_cast<float>(dwell[n+1]) - offset_q) * (1.f / 128.f);
+    }
+
+    fft_.skip(0);
+    fft_.execute(samples_, spectrum_);
+
+    std::size_t const frames = spectrum_.size() / (fft_length_ * 2);
+    std::fill(std::begin(bin_power_), std::end(bin_power_), 0.f);
+
+    for (std::size_t k = 0; k < frames; ++k) {
+        float const* spec = spectrum_.data() + k * fft_length_ * 2;
+
+        for (unsigned int bin = 0; bin < fft_length_; ++bin) {
+            bin_power_[bin] += spec[bin*2]*spec[bin*2] + spec[bin*2+1]*spec[bin*2+1];
+        }
+    }
+
+    float const peak = *std::max_element(std::begin(bin_power_), std::end(bin_power_));
+    auto middle = std::begin(bin_power_) + fft_length_ / 2;
+    std::nth_element(std::begin(bin_power_), middle, std::end(bin_power_));
+    float const noise = std::max(*middle, 1e-20f);
+
+    snr_db_[index] = 10.f * std::log10(std::max(peak, 1e-20f) / noise);
+    clipped_[index] = clipped > clip_limit_ * size;
+
+    std::cout << fmt::format(
+        "Gain {:5.1f} dB: noise {:6.1f} dBFS, SNR {:5.1f} dB{}",
+        gains_[index],
+        10.f * std::log10(noise / std::max<std::size_t>(frames, 1)),
+        snr_db_[index],
+        clipped_[index] ? ", clipping" : ""
+    ) << std::endl;
+}
+
+void GainCalibrator::selectBest(void)
+{
+    // With every gain clipping, the lowest one overloads the least
+    best_gain_ = gains_.front();
+    float best_snr = -1e9f;
+
+    // Gains are ascending, so a higher gain has to win by a margin to be picked
+    for (unsigned int n = 0; n < gains_.size(); ++n) {
+        if (! clipped_[n] && snr_db_[n] > best_snr + 0.5f) {
+            best_snr = snr_db_[n];
+            best_gain_ = gains_[n];
+        }
+    }
+
+    std::cout << fmt::format("Selected gain {:.1f} dB", best_gain_) << std::endl;
+}
+
+std::string GainCalibrator::defaultCachePath(void)
+{
+    return CacheDirectory::path() + "/gains.txt";
+}
+
+std::pair<bool, float> GainCalibrator::loadCachedGain(std::string const& path, std::string const& key)
+{
+    std::ifstream in{path};
+    std::string name;
+    float gain = 0.f;
+
+    // One "<key> <gain_db>" line per device
+    while (in >> name >> gain) {
+        if (name == key) {
+            return std::make_pair(true, gain);
+        }
+    }
+
+    return std::make_pair(false, 0.f);
+}
+
+bool GainCalibrator::storeCachedGain(std::string const& path, std::string const& key, float gain)
+{
+    std::vector<std::pair<std::string, float>> entries;
+
+    {
+        std::ifstream in{path};
+        std::string name;
+        float value = 0.f;
+
+        while (in >> name >> value) {
+            if (name != key) {
+                entries.emplace_back(name, value);
+            }
+        }
+    }
+
+    entries.emplace_back(key, gain);
+
+    // Written aside and renamed, so a crash never leaves a truncated cache
+    auto const tmp = path + ".tmp";
+
+    {
+        std::ofstream out{tmp, std::ios::trunc};
+
+        for (auto const& entry : entries) {
+            out << fmt::format("{} {:.1f}\n", entry.first, entry.second);
+        }
+
+        if (! out) {
+            return false;
+        }
+    }
+
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
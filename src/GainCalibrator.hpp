@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_GAINCALIBRATOR_HPP
+#define JDRADIO_GAINCALIBRATOR_HPP
+
+#include "SampleSource.hpp"
+#include "FFT.hpp"
+#include "DwellSequencer.hpp"
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+
+//! Sweeps the tuner gains and picks the one giving the best SNR on a reference
+//! signal, which has to be on the air during the sweep.
+//!
+//! Each gain is measured over a short dwell with its DC offset removed: the
+//! median bin of the averaged spectrum is the noise floor and the strongest bin
+//! is the reference. Gains
+//! that clip the ADC are rejected. Gain changes go through a DwellSequencer,
+//! and the next change is requested before the previous dwell is measured.
+class GainCalibrator
+{
+public:
+    GainCalibrator(void) noexcept;
+    ~GainCalibrator(void) noexcept;
+
+    void setDwellTime(std::chrono::milliseconds dwell);
+    void setSettleTime(std::chrono::milliseconds settle);
+    void setFFTLength(unsigned int len);
+    void setClipLimit(float ratio);
+
+    bool start(SampleSource& source, std::vector<float> const& gains, unsigned int sample_rate);
+    void stop(void) noexcept;
+    bool onSamples(std::vector<std::uint8_t> const& in);
+    float bestGain(void) const noexcept;
+
+    static std::string defaultCachePath(void);
+    static std::pair<bool, float> loadCachedGain(std::string const& path, std::string const& key);
+    static bool storeCachedGain(std::string const& path, std::string const& key, float gain);
+
+private:
+    void measureDwell(unsigned int index, std::vector<std::uint8_t> const& dwell);
+    void selectBest(void);
+
+    std::chrono::milliseconds dwell_time_;
+    std::chrono::milliseconds settle_time_;
+    unsigned int fft_length_;
+    float clip_limit_;
+
+    SampleSource* source_;
+    unsigned int sample_rate_;
+    std::vector<float> gains_;
+    std::vector<float> snr_db_;
+    std::vector<bool> clipped_;
+    FFT fft_;
+    DwellSequencer sequencer_;
+    unsigned int current_;
+    bool finishing_;
+    bool done_;
+    float best_gain_;
+    std::vector<float> samples_;
+    std::vector<float> spectrum_;
+    std::vector<float> bin_power_;
+    bool running_;
+};
+
+#endif
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "JitterMeter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fmt/format.h>
+
+//! Width of a histogram bucket
+static constexpr double BUCKET_US = 10.0;
+
+//! Deviations past the last bucket (100 ms) all land in it
+static constexpr std::size_t BUCKETS = 10000;
+
+JitterMeter::JitterMeter(void) :
+    sample_rate_{256'000U},
+    last_{},
+    started_{false},
+    histogram_(BUCKETS, 0),
+    intervals_{0},
+    late_{0},
+    expected_us_{0.0},
+    sum_us_{0.0},
+    min_us_{0.0},
+    max_us_{0.0},
+    max_deviation_us_{0.0},
+    mutex_{}
+{
+}
+
+void JitterMeter::setSampleRate(unsigned int rate) noexcept
+{
+    sample_rate_ = rate;
+}
+
+void JitterMeter::onBuffer(std::size_t samples) noexcept
+{
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    if (! started_) {
+        // The first buffer only starts the clock
+        started_ = true;
+        last_ = now;
+        return;
+    }
+
+    double const interval_us = std::chrono::duration<double, std::micro>(now - last_).count();
+    last_ = now;
+
+    // The buffer that just arrived took this long to fill
+    expected_us_ = samples * 1e6 / sample_rate_;
+    double const deviation_us = std::fabs(interval_us - expected_us_);
+    std::size_t const bucket = std::min(static_cast<std::size_t>(deviation_us / BUCKET_US), BUCKETS - 1);
+
+    ++histogram_[bucket];
+    sum_us_ += interval_us;
+    min_us_ = intervals_ == 0 ? interval_us : std::min(min_us_, interval_us);
+    max_us_ = std::max(max_us_, interval_us);
+    max_deviation_us_ = std::max(max_deviation_us_, deviation_us);
+
+    if (interval_us > 1.5 * expected_us_) {
+        ++late_;
+    }
+
+    ++intervals_;
+}
+
+double JitterMeter::percentile(double fraction) const noexcept
+{
+    auto const rank = static_cast<std::uint64_t>(std::ceil(fraction * intervals_));
+    std::uint64_t seen = 0;
+
+    for (std::size_t n = 0; n + 1 < BUCKETS; ++n) {
+        seen += histogram_[n];
+
+        if (seen >= rank) {
+            // Upper edge of the bucket, but never past the worst deviation seen
+            return std::min((n + 1) * BUCKET_US, max_deviation_us_);
+        }
+    }
+
+    return max_deviation_us_;
+}
+
+std::string JitterMeter::summary(void) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    if (intervals_ == 0) {
+        return "jitter_intervals 0\n";
+    }
+
+    return fmt::format(
+        "jitter_intervals {}\njitter_expected_us {:.0f}\njitter_min_us {:.0f}\njitter_mean_us {:.0f}\njitter_max_us {:.0f}\njitter_p50_deviation_us {:.0f}\njitter_p99_deviation_us {:.0f}\njitter_p999_deviation_us {:.0f}\njitter_max_deviation_us {:.0f}\njitter_late_buffers {}\n",
+        intervals_,
+        expected_us_,
+        min_us_,
+        sum_us_ / intervals_,
+        max_us_,
+        percentile(0.5),
+        percentile(0.99),
+        percentile(0.999),
+        max_deviation_us_,
+        late_
+    );
+}
@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_JITTERMETER_HPP
+#define JDRADIO_JITTERMETER_HPP
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+
+//! Measures the time between consecutive sample buffers.
+//!
+//! Each interval is compared with the time the buffer's samples take at the
+//! sample rate, and the deviation goes into a histogram of 10 us buckets, so
+//! percentiles come without keeping every interval. A buffer arriving more
+//! than half an interval late counts as late.
+class JitterMeter
+{
+public:
+    JitterMeter(void);
+
+    void setSampleRate(unsigned int rate) noexcept;
+    //! Called from the sample thread as each buffer arrives
+    void onBuffer(std::size_t samples) noexcept;
+    //! "key value" lines, as in the control socket's metrics
+    std::string summary(void) const;
+
+private:
+    double percentile(double fraction) const noexcept;
+
+    unsigned int sample_rate_;
+    std::chrono::steady_clock::time_point last_;
+    bool started_;
+    std::vector<std::uint64_t> histogram_;
+    std::uint64_t intervals_;
+    std::uint64_t late_;
+    double expected_us_;
+    double sum_us_;
+    double min_us_;
+    double max_us_;
+    double max_deviation_us_;
+    mutable std::mutex mutex_;
+};
+
+#endif
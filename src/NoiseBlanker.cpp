@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "NoiseBlanker.hpp"
+#include <algorithm>
+#include <cmath>
+
+constexpr unsigned int NoiseBlanker::BLOCK_LENGTH;
+
+NoiseBlanker::NoiseBlanker(void) noexcept :
+    threshold_{0.f},
+    max_pulse_width_{8},
+    envelope_{-1.f},
+    run_start_{0},
+    run_length_{0},
+    last_i_{0.f},
+    last_q_{0.f},
+    power_{},
+    blanked_samples_{0}
+{
+    setThreshold(15.f);
+}
+
+void NoiseBlanker::setThreshold(float db) noexcept
+{
+    threshold_ = std::pow(10.f, db / 10.f);
+}
+
+void NoiseBlanker::setMaxPulseWidth(unsigned int samples) noexcept
+{
+    max_pulse_width_ = std::max(samples, 1U);
+}
+
+unsigned int NoiseBlanker::repair(float* data, unsigned int num_samples, unsigned int first, unsigned int end) noexcept
+{
+    // One sample of margin on each side, for the skirts of the pulse left by the dongle's filters
+    first = first > 0 ? first - 1 : 0;
+    end = std::min(end + 1, num_samples);
+
+    float const left_i = first > 0 ? data[(first-1)*2] : last_i_;
+    float const left_q = first > 0 ? data[(first-1)*2+1] : last_q_;
+    // A run still open at the end of the buffer holds the last good sample
+    float const right_i = end < num_samples ? data[end*2] : left_i;
+    float const right_q = end < num_samples ? data[end*2+1] : left_q;
+    unsigned int const length = end - first;
+
+    for (unsigned int n = 0; n < length; ++n) {
+        float const t = (n + 1.f) / (length + 1.f);
+        data[(first+n)*2] = left_i + t * (right_i - left_i);
+        data[(first+n)*2+1] = left_q + t * (right_q - left_q);
+    }
+
+    return length;
+}
+
+unsigned int NoiseBlanker::execute(std::vector<float>& samples) noexcept
+{
+    unsigned int const num_samples = samples.size() / 2;
+    float* data = samples.data();
+    float* power = power_.data();
+    unsigned int blanked = 0;
+
+    if (num_samples == 0) {
+        return 0;
+    }
+
+    for (unsigned int start = 0; start < num_samples; start += BLOCK_LENGTH) {
+        unsigned int const count = std::min(BLOCK_LENGTH, num_samples - start);
+        float const* block = data + start * 2;
+
+        for (unsigned int n = 0; n < count; ++n) {
+            power[n] = block[n*2] * block[n*2] + block[n*2+1] * block[n*2+1];
+        }
+
+        // Only the last block of a buffer can be short, and zeros are never above the limit
+        for (unsigned int n = count; n < BLOCK_LENGTH; ++n) {
+            power[n] = 0.f;
+        }
+
+        // Separate partial sums, since the compiler may not reorder a single float sum
+        float sums[4] = {0.f, 0.f, 0.f, 0.f};
+
+        for (unsigned int n = 0; n < BLOCK_LENGTH; n += 4) {
+            sums[0] += power[n];
+            sums[1] += power[n+1];
+            sums[2] += power[n+2];
+            sums[3] += power[n+3];
+        }
+
+        float const total = sums[0] + sums[1] + sums[2] + sums[3];
+
+        if (envelope_ < 0.f) {
+            envelope_ = total / count;
+        }
+
+        float const limit = envelope_ * threshold_;
+        unsigned int hits = 0;
+
+        for (unsigned int n = 0; n < BLOCK_LENGTH; ++n) {
+            hits += power[n] > limit ? 1 : 0;
+        }
+
+        float excluded = 0.f;
+
+        // Blocks without a spike skip the walk. A repair may reach the next sample of the
+        // block, whose power was measured before the repair, as it should be.
+        if (hits > 0 || run_length_ > 0) {
+            for (unsigned int n = 0; n < count; ++n) {
+                if (power[n] > limit) {
+                    if (run_length_++ == 0) {
+                        run_start_ = start + n;
+                    }
+
+                    excluded += power[n];
+                }
+                else if (run_length_ > 0) {
+                    if (run_length_ <= max_pulse_width_) {
+                        blanked += repair(data, num_samples, run_start_, start + n);
+                    }
+
+                    run_length_ = 0;
+                }
+            }
+        }
+
+        // The envelope follows the blocks down immediately and up slowly. A block mostly
+        // above the limit carries a signal and counts in full, otherwise spikes are left out.
+        float mean = 0.f;
+
+        if (hits > max_pulse_width_) {
+            mean = total / count;
+        }
+        else if (hits < count) {
+            mean = (total - excluded) / (count - hits);
+        }
+        else {
+            continue;
+        }
+
+        if (mean < envelope_) {
+            envelope_ = mean;
+        }
+        else {
+            envelope_ += 0.2f * (mean - envelope_);
+        }
+    }
+
+    // A pulse running into the next buffer is blanked now; if it turns out to be the
+    // start of a transmission, only its first few samples are lost
+    if (run_length_ > 0) {
+        if (run_length_ <= max_pulse_width_) {
+            blanked += repair(data, num_samples, run_start_, num_samples);
+        }
+
+        run_start_ = 0;
+    }
+
+    last_i_ = data[(num_samples-1)*2];
+    last_q_ = data[(num_samples-1)*2+1];
+
+    blanked_samples_.fetch_add(blanked, std::memory_order_relaxed);
+
+    return blanked;
+}
+
+std::uint64_t NoiseBlanker::blankedSamples(void) const noexcept
+{
+    return blanked_samples_.load(std::memory_order_relaxed);
+}
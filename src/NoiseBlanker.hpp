@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_NOISEBLANKER_HPP
+#define JDRADIO_NOISEBLANKER_HPP
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+//! Removes impulse noise, such as ignition spikes, from converted samples.
+//!
+//! The power envelope is tracked per block of 64 samples. A run of samples
+//! rising above the envelope by the threshold is replaced by a straight line
+//! between its neighbours, as long as it is no wider than the maximum pulse
+//! width; a longer run is a real signal and passes untouched. The power and
+//! comparison loops are written for the compiler to vectorize, and blocks
+//! without a spike never reach the scalar repair code.
+class NoiseBlanker
+{
+public:
+    NoiseBlanker(void) noexcept;
+
+    void setThreshold(float db) noexcept;
+    void setMaxPulseWidth(unsigned int samples) noexcept;
+    //! Blanks the interleaved I/Q samples in place and returns how many were replaced
+    unsigned int execute(std::vector<float>& samples) noexcept;
+    std::uint64_t blankedSamples(void) const noexcept;
+
+private:
+    static constexpr unsigned int BLOCK_LENGTH = 64;
+
+    unsigned int repair(float* data, unsigned int num_samples, unsigned int first, unsigned int end) noexcept;
+
+    float threshold_;
+    unsigned int max_pulse_width_;
+    float envelope_;
+    unsigned int run_start_;
+    unsigned int run_length_;
+    float last_i_;
+    float last_q_;
+    std::array<float, BLOCK_LENGTH> power_;
+    std::atomic<std::uint64_t> blanked_samples_;
+};
+
+#endif
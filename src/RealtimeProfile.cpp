@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "RealtimeProfile.hpp"
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <cstddef>
+#include <fmt/format.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+//! Stack touched by the sample thread up front, well above what a buffer needs
+static constexpr std::size_t STACK_PREFAULT = 256 * 1024;
+
+static void prefaultStack(void)
+{
+    unsigned char volatile stack[STACK_PREFAULT];
+
+    for (std::size_t n = 0; n < STACK_PREFAULT; n += 4096) {
+        stack[n] = 0;
+    }
+
+    (void) stack;
+}
+
+RealtimeProfile::RealtimeProfile(void) noexcept :
+    lock_memory_{true},
+    core_{-1},
+    priority_{0}
+{
+}
+
+void RealtimeProfile::setLockMemory(bool on) noexcept
+{
+    lock_memory_ = on;
+}
+
+void RealtimeProfile::setCore(int core) noexcept
+{
+    core_ = core;
+}
+
+void RealtimeProfile::setPriority(int priority) noexcept
+{
+    priority_ = priority;
+}
+
+bool RealtimeProfile::applyProcess(void)
+{
+    if (! lock_memory_) {
+        return true;
+    }
+
+    // Freed memory stays in the heap rather than going back to the kernel, to be faulted in again later
+    ::mallopt(M_TRIM_THRESHOLD, -1);
+
+    struct rlimit limit{};
+    ::getrlimit(RLIMIT_MEMLOCK, &limit);
+
+    // Under a finite limit, MCL_FUTURE would turn later allocations into failures once it is reached
+    bool const unlimited = limit.rlim_cur == RLIM_INFINITY || ::geteuid() == 0;
+
+    if (::mlockall(unlimited ? MCL_CURRENT | MCL_FUTURE : MCL_CURRENT) < 0) {
+        std::cerr << fmt::format("Real-time: memory not locked ({}, RLIMIT_MEMLOCK {} KiB)", std::strerror(errno), limit.rlim_cur / 1024) << std::endl;
+        return false;
+    }
+
+    std::cout << fmt::format("Real-time: memory locked{}", unlimited ? "" : ", current mappings only") << std::endl;
+    return true;
+}
+
+bool RealtimeProfile::applyThread(void)
+{
+    bool ok = true;
+
+    if (core_ >= CPU_SETSIZE) {
+        std::cerr << fmt::format("Real-time: core {} is past the last one a cpu_set_t can hold ({})", core_, CPU_SETSIZE - 1) << std::endl;
+        ok = false;
+    }
+    else if (core_ >= 0) {
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(core_, &cores);
+
+        int const result = ::pthread_setaffinity_np(::pthread_self(), sizeof(cores), &cores);
+
+        if (result != 0) {
+            std::cerr << fmt::format("Real-time: sample thread not pinned to core {} ({})", core_, std::strerror(result)) << std::endl;
+            ok = false;
+        }
+        else {
+            std::cout << fmt::format("Real-time: sample thread pinned to core {}", core_) << std::endl;
+        }
+    }
+
+    if (priority_ > 0) {
+        sched_param param{};
+        param.sched_priority = priority_;
+
+        int const result = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+
+        if (result != 0) {
+            std::cerr << fmt::format("Real-time: SCHED_FIFO priority {} refused ({}), staying on SCHED_OTHER", priority_, std::strerror(result)) << std::endl;
+            ok = false;
+        }
+        else {
+            std::cout << fmt::format("Real-time: sample thread on SCHED_FIFO priority {}", priority_) << std::endl;
+        }
+    }
+
+    // A new thread's stack is only locked in full under MCL_FUTURE, this covers the other cases
+    if (lock_memory_) {
+        prefaultStack();
+    }
+
+    return ok;
+}
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_REALTIMEPROFILE_HPP
+#define JDRADIO_REALTIMEPROFILE_HPP
+
+//! Real-time settings for the thread that receives and processes the samples.
+//!
+//! The process part locks memory, so buffers allocated so far are faulted in
+//! and never paged out. The thread part pins the calling thread to a core and
+//! moves it to SCHED_FIFO. Each step reports what it applied, and a step that
+//! lacks the privileges is skipped, leaving the default behaviour in place.
+class RealtimeProfile
+{
+public:
+    RealtimeProfile(void) noexcept;
+
+    void setLockMemory(bool on) noexcept;
+    //! A negative core leaves the thread free to run anywhere
+    void setCore(int core) noexcept;
+    //! SCHED_FIFO priority, 0 keeps the thread on SCHED_OTHER
+    void setPriority(int priority) noexcept;
+
+    //! From the main thread, once the processing buffers are allocated
+    bool applyProcess(void);
+    //! From the sample thread, before its first buffer
+    bool applyThread(void);
+
+private:
+    bool lock_memory_;
+    int core_;
+    int priority_;
+};
+
+#endif
@@ -0,0 +1,406 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "Recorder.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <cstdio>
+#include <system_error>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static std::string formatDateTime(std::chrono::system_clock::time_point tp, bool compact)
+{
+    auto const secs = std::chrono::system_clock::to_time_t(tp);
+    auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count() % 1000;
+    std::tm t{};
+    gmtime_r(&secs, &t);
+
+    if (compact) {
+        return fmt::format("{:04}{:02}{:02}T{:02}{:02}{:02}Z", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    }
+
+    return fmt::format("{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:03}Z", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, ms);
+}
+
+Recorder::Recorder(void) noexcept :
+    directory_{"."},
+    block_size_{1U << 20},
+    backlog_length_{16},
+    max_file_size_{1ULL << 30},
+    max_file_duration_{std::chrono::hours{1}},
+    frequency_{0},
+    sample_rate_{0},
+    gain_{0.f},
+    blocks_{},
+    free_blocks_{},
+    full_blocks_{},
+    current_{},
+    has_current_{false},
+    sample_count_{0},
+    pending_drop_{0},
+    dropped_samples_{0},
+    falling_behind_{false},
+    mutex_{},
+    cv_{},
+    writer_{},
+    running_{false},
+    fd_{-1},
+    file_base_{},
+    file_index_{0},
+    file_size_{0},
+    file_sample_start_{0},
+    file_time_{},
+    file_drops_{}
+{
+}
+
+Recorder::~Recorder(void) noexcept
+{
+    stop();
+    releaseBlocks();
+}
+
+void Recorder::setDirectory(std::string const& dir)
+{
+    directory_ = dir;
+}
+
+void Recorder::setBlockSize(std::size_t size)
+{
+    // Keep blocks a multiple of the page size so every write stays aligned
+    block_size_ = std::max<std::size_t>(4096, (size + 4095) & ~static_cast<std::size_t>(4095));
+    releaseBlocks();
+}
+
+void Recorder::setBacklogLength(unsigned int blocks)
+{
+    backlog_length_ = std::max(2U, blocks);
+    releaseBlocks();
+}
+
+void Recorder::setMaxFileSize(std::uint64_t size)
+{
+    max_file_size_ = size;
+}
+
+void Recorder::setMaxFileDuration(std::chrono::seconds duration)
+{
+    max_file_duration_ = duration;
+}
+
+bool Recorder::start(unsigned int frequency, unsigned int sample_rate, float gain)
+{
+    if (running_) {
+        return false;
+    }
+
+    frequency_ = frequency;
+    sample_rate_ = sample_rate;
+    gain_ = gain;
+
+    if (blocks_.empty()) {
+        for (unsigned int n = 0; n < backlog_length_; ++n) {
+            void* ptr = nullptr;
+
+            if (posix_memalign(&ptr, 4096, block_size_) != 0) {
+                std::cerr << "Failed to allocate recorder buffers" << std::endl;
+                releaseBlocks();
+                return false;
+            }
+
+            blocks_.push_back(static_cast<std::uint8_t*>(ptr));
+        }
+    }
+
+    free_blocks_.clear();
+    full_blocks_.clear();
+    // Both lists hold at most every block, so queuing never allocates
+    free_blocks_.reserve(blocks_.size());
+    full_blocks_.reserve(blocks_.size());
+
+    for (auto* ptr : blocks_) {
+        free_blocks_.push_back(Block{ptr, 0, 0, 0, {}});
+    }
+
+    has_current_ = false;
+    sample_count_ = 0;
+    pending_drop_ = 0;
+    dropped_samples_ = 0;
+    falling_behind_ = false;
+    running_ = true;
+
+    try {
+        writer_ = std::thread{&Recorder::writerLoop, this};
+    }
+    catch (std::system_error const&) {
+        std::cerr << "Failed to start recorder thread" << std::endl;
+        running_ = false;
+        return false;
+    }
+
+    return true;
+}
+
+void Recorder::stop(void) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        if (has_current_ && current_.size_ > 0) {
+            full_blocks_.push_back(current_);
+        }
+
+        has_current_ = false;
+        running_ = false;
+    }
+
+    cv_.notify_one();
+
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void Recorder::setGain(float gain) noexcept
+{
+    // Read by the writer thread when it closes a file
+    gain_ = gain;
+}
+
+std::uint64_t Recorder::onSamples(std::vector<std::uint8_t> const& in) noexcept
+{
+    std::size_t const in_size = in.size() & ~static_cast<std::size_t>(1);
+    std::size_t offset = 0;
+    std::uint64_t dropped = 0;
+    bool started_dropping = false;
+    bool recovered = false;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return 0;
+        }
+
+        while (offset < in_size) {
+            if (! has_current_) {
+                if (free_blocks_.empty()) {
+                    dropped = (in_size - offset) / 2;
+                    pending_drop_ += dropped;
+                    dropped_samples_ += dropped;
+                    started_dropping = ! falling_behind_;
+                    falling_behind_ = true;
+                    break;
+                }
+
+                current_ = free_blocks_.back();
+                free_blocks_.pop_back();
+                current_.size_ = 0;
+                current_.sample_start_ = sample_count_;
+                current_.dropped_before_ = pending_drop_;
+                current_.time_ = std::chrono::system_clock::now();
+                has_current_ = true;
+                pending_drop_ = 0;
+
+                recovered = recovered || falling_behind_;
+                falling_behind_ = false;
+            }
+
+            std::size_t const n = std::min(block_size_ - current_.size_, in_size - offset);
+            std::memcpy(current_.data_ + current_.size_, in.data() + offset, n);
+            current_.size_ += n;
+            offset += n;
+            sample_count_ += n / 2;
+
+            if (current_.size_ == block_size_) {
+                full_blocks_.push_back(current_);
+                has_current_ = false;
+                cv_.notify_one();
+            }
+        }
+    }
+
+    if (recovered) {
+        fmt::print(stderr, "Recorder caught up, {} samples dropped so far\n", droppedSamples());
+    }
+
+    if (started_dropping) {
+        fmt::print(stderr, "Recorder is falling behind, dropped {} samples\n", dropped);
+    }
+
+    return dropped;
+}
+
+std::uint64_t Recorder::droppedSamples(void) const noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return dropped_samples_;
+}
+
+void Recorder::writerLoop(void)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        cv_.wait(lock, [this] { return ! full_blocks_.empty() || ! running_; });
+
+        if (full_blocks_.empty()) {
+            break;
+        }
+
+        Block block = full_blocks_.front();
+        full_blocks_.erase(std::begin(full_blocks_));
+        lock.unlock();
+
+        bool const rotate = fd_ >= 0 && (
+            file_size_ >= max_file_size_ ||
+            block.time_ - file_time_ >= max_file_duration_
+        );
+
+        if (rotate) {
+            closeFile();
+        }
+
+        if (fd_ >= 0 || openFile(block)) {
+            if (block.dropped_before_ > 0) {
+                file_drops_.emplace_back(block.sample_start_ - file_sample_start_, block.dropped_before_, block.time_);
+            }
+
+            std::size_t written = 0;
+
+            while (written < block.size_) {
+                ssize_t result = ::write(fd_, block.data_ + written, block.size_ - written);
+
+                if (result < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    std::cerr << fmt::format("Failed to write recording: {}", std::strerror(errno)) << std::endl;
+                    break;
+                }
+
+                written += result;
+            }
+
+            file_size_ += written;
+        }
+
+        lock.lock();
+        free_blocks_.push_back(block);
+    }
+
+    lock.unlock();
+    closeFile();
+}
+
+bool Recorder::openFile(Block const& first)
+{
+    file_base_ = fmt::format("{}/arcal-{}-{:04}", directory_, formatDateTime(first.time_, true), file_index_++);
+    fd_ = ::open((file_base_ + ".sigmf-data").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd_ < 0) {
+        std::cerr << fmt::format("Failed to open recording {}: {}", file_base_, std::strerror(errno)) << std::endl;
+        return false;
+    }
+
+    file_size_ = 0;
+    file_sample_start_ = first.sample_start_;
+    file_time_ = first.time_;
+    file_drops_.clear();
+
+    std::cout << fmt::format("Recording to {}.sigmf-data", file_base_) << std::endl;
+
+    return true;
+}
+
+void Recorder::closeFile(void)
+{
+    if (fd_ < 0) {
+        return;
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+
+    writeMetadata();
+}
+
+void Recorder::writeMetadata(void)
+{
+    std::ofstream meta{file_base_ + ".sigmf-meta", std::ios::trunc};
+
+    if (! meta) {
+        std::cerr << fmt::format("Failed to write metadata for {}", file_base_) << std::endl;
+        return;
+    }
+
+    meta << "{\n";
+    meta << "  \"global\": {\n";
+    meta << "    \"core:datatype\": \"cu8\",\n";
+    meta << fmt::format("    \"core:sample_rate\": {},\n", sample_rate_);
+    meta << "    \"core:version\": \"1.0.0\",\n";
+    meta << "    \"core:recorder\": \"ARCAL\",\n";
+    meta << "    \"core:hw\": \"RTL-SDR\",\n";
+    meta << "    \"core:extensions\": [{\"name\": \"arcal\", \"version\": \"1.0.0\", \"optional\": true}],\n";
+    meta << fmt::format("    \"arcal:gain_db\": {:.1f}\n", gain_.load());
+    meta << "  },\n";
+
+    meta << "  \"captures\": [\n";
+    meta << fmt::format("    {{\"core:sample_start\": 0, \"core:frequency\": {}, \"core:datetime\": \"{}\"}}", frequency_, formatDateTime(file_time_, false));
+
+    // Every drop is a discontinuity, which SigMF represents as a new capture segment
+    for (auto const& drop : file_drops_) {
+        // A gap before the file's first sample is already covered by the capture above
+        if (std::get<0>(drop) == 0) {
+            continue;
+        }
+
+        meta << fmt::format(",\n    {{\"core:sample_start\": {}, \"core:frequency\": {}, \"core:datetime\": \"{}\"}}", std::get<0>(drop), frequency_, formatDateTime(std::get<2>(drop), false));
+    }
+
+    meta << "\n  ],\n";
+
+    meta << "  \"annotations\": [";
+    for (unsigned int n = 0; n < file_drops_.size(); ++n) {
+        auto const& drop = file_drops_[n];
+        meta << (n > 0 ? ",\n" : "\n");
+        meta << fmt::format(
+            "    {{\"core:sample_start\": {}, \"core:comment\": \"{} samples dropped\", \"arcal:dropped_samples\": {}}}",
+            std::get<0>(drop),
+            std::get<1>(drop),
+            std::get<1>(drop)
+        );
+    }
+    meta << (file_drops_.empty() ? "]\n" : "\n  ]\n");
+    meta << "}\n";
+}
+
+void Recorder::releaseBlocks(void) noexcept
+{
+    if (running_) {
+        return;
+    }
+
+    for (auto* ptr : blocks_) {
+        std::free(ptr);
+    }
+
+    blocks_.clear();
+    free_blocks_.clear();
+    full_blocks_.clear();
+}
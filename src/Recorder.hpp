@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_RECORDER_HPP
+#define JDRADIO_RECORDER_HPP
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+
+//! Records the raw cu8 stream to rotating SigMF recordings.
+//!
+//! Samples are batched into large aligned blocks on the caller's thread and
+//! written sequentially by a background thread. The number of blocks is fixed,
+//! so the backlog is bounded: when every block is waiting to be written, the
+//! incoming samples are dropped and an annotation is added to the metadata.
+class Recorder
+{
+public:
+    Recorder(void) noexcept;
+    ~Recorder(void) noexcept;
+
+    void setDirectory(std::string const& dir);
+    void setBlockSize(std::size_t size);
+    void setBacklogLength(unsigned int blocks);
+    void setMaxFileSize(std::uint64_t size);
+    void setMaxFileDuration(std::chrono::seconds duration);
+
+    bool start(unsigned int frequency, unsigned int sample_rate, float gain);
+    void stop(void) noexcept;
+    //! For a gain that changes after start(), such as a calibrated one
+    void setGain(float gain) noexcept;
+    //! Returns the number of samples from this buffer that had to be dropped
+    std::uint64_t onSamples(std::vector<std::uint8_t> const& in) noexcept;
+    std::uint64_t droppedSamples(void) const noexcept;
+
+private:
+    struct Block
+    {
+        std::uint8_t* data_;
+        std::size_t size_;
+        std::uint64_t sample_start_;
+        std::uint64_t dropped_before_;
+        std::chrono::system_clock::time_point time_;
+    };
+
+    void writerLoop(void);
+    bool openFile(Block const& first);
+    void closeFile(void);
+    void writeMetadata(void);
+    void releaseBlocks(void) noexcept;
+
+    std::string directory_;
+    std::size_t block_size_;
+    unsigned int backlog_length_;
+    std::uint64_t max_file_size_;
+    std::chrono::seconds max_file_duration_;
+
+    unsigned int frequency_;
+    unsigned int sample_rate_;
+    std::atomic<float> gain_;
+
+    std::vector<std::uint8_t*> blocks_;
+    std::vector<Block> free_blocks_;
+    std::vector<Block> full_blocks_;
+    Block current_;
+    bool has_current_;
+    std::uint64_t sample_count_;
+    std::uint64_t pending_drop_;
+    std::uint64_t dropped_samples_;
+    bool falling_behind_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread writer_;
+    bool running_;
+
+    // Writer thread state
+    int fd_;
+    std::string file_base_;
+    unsigned int file_index_;
+    std::uint64_t file_size_;
+    std::uint64_t file_sample_start_;
+    std::chrono::system_clock::time_point file_time_;
+    std::vector<std::tuple<std::uint64_t, std::uint64_t, std::chrono::system_clock::time_point>> file_drops_;
+};
+
+#endif
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_SAMPLESOURCE_HPP
+#define JDRADIO_SAMPLESOURCE_HPP
+
+#include <vector>
+#include <utility>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+//! Tunable source of cu8 IQ samples.
+//!
+//! readAsync() blocks and hands every buffer to the handler on the calling
+//! thread until cancelAsync() is called. The buffer is reused for the next
+//! read unless the handler moves it away.
+class SampleSource
+{
+public:
+    struct Exception : std::exception
+    {
+        int code_;
+        char const* message_;
+
+        Exception(int code, char const* message) noexcept :
+            std::exception{},
+            code_{code},
+            message_{message}
+        {
+        }
+
+        virtual ~Exception(void) noexcept
+        {
+        }
+
+        char const* what(void) const noexcept override
+        {
+            return message_;
+        }
+
+        int code(void) const noexcept
+        {
+            return code_;
+        }
+    };
+
+    virtual ~SampleSource(void) noexcept
+    {
+    }
+
+    virtual bool setCenterFrequency(unsigned int freq) noexcept = 0;
+    virtual bool setSampleRate(unsigned int rate) noexcept = 0;
+    virtual bool resetBuffer(void) noexcept = 0;
+    virtual bool setAgcMode(bool on) noexcept = 0;
+    virtual bool setGain(float gain) noexcept = 0;
+    virtual std::pair<bool, std::vector<float>> listGains(void) noexcept = 0;
+    virtual bool setBufferLength(std::size_t bytes) noexcept = 0;
+    virtual bool readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept = 0;
+    virtual bool cancelAsync(void) noexcept = 0;
+};
+
+#endif
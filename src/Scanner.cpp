@@ -0,0 +1,301 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "Scanner.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <system_error>
+#include <fmt/format.h>
+
+Scanner::Scanner(void) noexcept :
+    channels_{},
+    dwell_time_{100},
+    settle_time_{5},
+    fft_length_{256},
+    threshold_{std::pow(10.f, -60.f / 10.f)},
+    report_path_{"scan-report.csv"},
+    source_{nullptr},
+    sample_rate_{0},
+    fft_{},
+    sequencer_{},
+    current_{0},
+    samples_{},
+    spectrum_{},
+    passes_{0},
+    pass_start_{},
+    running_{false},
+    pending_{},
+    pending_passes_{0},
+    pending_seconds_{0.f},
+    report_pending_{false},
+    report_{},
+    report_passes_{0},
+    report_seconds_{0.f},
+    mutex_{},
+    cv_{},
+    writer_{},
+    writing_{false}
+{
+}
+
+Scanner::~Scanner(void) noexcept
+{
+    stop();
+}
+
+void Scanner::setChannels(std::vector<unsigned int> const& frequencies)
+{
+    channels_.clear();
+
+    for (auto freq : frequencies) {
+        channels_.push_back(Channel{freq, 0, {}, {}, {}});
+    }
+}
+
+void Scanner::setRange(unsigned int start, unsigned int stop, unsigned int step)
+{
+    std::vector<unsigned int> frequencies;
+
+    for (unsigned int freq = start; freq <= stop && step > 0; freq += step) {
+        frequencies.push_back(freq);
+    }
+
+    setChannels(frequencies);
+}
+
+void Scanner::setDwellTime(std::chrono::milliseconds dwell)
+{
+    dwell_time_ = dwell;
+}
+
+void Scanner::setSettleTime(std::chrono::milliseconds settle)
+{
+    settle_time_ = settle;
+}
+
+void Scanner::setFFTLength(unsigned int len)
+{
+    fft_length_ = len;
+}
+
+void Scanner::setThreshold(float db)
+{
+    threshold_ = std::pow(10.f, db / 10.f);
+}
+
+void Scanner::setReportPath(std::string const& path)
+{
+    report_path_ = path;
+}
+
+bool Scanner::start(SampleSource& source, unsigned int sample_rate)
+{
+    if (running_ || channels_.empty()) {
+        return false;
+    }
+
+    source_ = &source;
+    sample_rate_ = sample_rate;
+
+    fft_.setLength(fft_length_);
+    fft_.setWindow(FFT::Window::Hann);
+
+    for (auto& channel : channels_) {
+        channel.frames_ = 0;
+        channel.sum_.assign(fft_length_, 0.0);
+        channel.max_.assign(fft_length_, 0.f);
+        channel.occupied_.assign(fft_length_, 0);
+    }
+
+    std::size_t const dwell_size = static_cast<std::size_t>(sample_rate_ * dwell_time_.count() / 1000) * 2;
+    samples_.resize(dwell_size);
+    spectrum_.reserve((dwell_size / 2 / fft_length_ + 1) * fft_length_ * 2);
+
+    passes_ = 0;
+    current_ = 0;
+
+    sequencer_.setDwellTime(dwell_time_);
+    sequencer_.setSettleTime(settle_time_);
+
+    bool const started = sequencer_.start(sample_rate_, [this] (double frequency) {
+        if (! source_->setCenterFrequency(static_cast<unsigned int>(frequency))) {
+            std::cerr << fmt::format("Failed to tune to {:.3f} MHz", frequency / 1e6) << std::endl;
+        }
+    });
+
+    if (! started) {
+        return false;
+    }
+
+    report_pending_ = false;
+    writing_ = true;
+
+    try {
+        writer_ = std::thread{&Scanner::writerLoop, this};
+    }
+    catch (std::system_error const&) {
+        std::cerr << "Failed to start scan report thread" << std::endl;
+        writing_ = false;
+        sequencer_.stop();
+        return false;
+    }
+
+    running_ = true;
+    pass_start_ = std::chrono::steady_clock::now();
+    sequencer_.request(channels_[current_].frequency_);
+
+    return true;
+}
+
+void Scanner::stop(void) noexcept
+{
+    sequencer_.stop();
+    running_ = false;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        writing_ = false;
+    }
+
+    cv_.notify_one();
+
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void Scanner::onSamples(std::vector<std::uint8_t> const& in)
+{
+    if (! running_ || ! sequencer_.onSamples(in)) {
+        return;
+    }
+
+    auto& channel = channels_[current_];
+    current_ = (current_ + 1) % channels_.size();
+
+    // Retune first so the analysis below overlaps with the settling time
+    sequencer_.request(channels_[current_].frequency_);
+    processDwell(channel, sequencer_.dwell());
+
+    if (current_ == 0) {
+        queueReport();
+    }
+}
+
+void Scanner::processDwell(Channel& channel, std::vector<std::uint8_t> const& dwell)
+{
+    std::size_t const size = dwell.size();
+
+    for (std::size_t n = 0; n < size; ++n) {
+        samples_[n] = (static_cast<float>(dwell[n]) - 127.5f) * (1.f / 128.f);
+    }
+
+    // Each dwell is analyzed on its own, without history from the previous channel
+    fft_.skip(0);
+    fft_.execute(samples_, spectrum_);
+
+    std::size_t const frames = spectrum_.size() / (fft_length_ * 2);
+    float const* spec = spectrum_.data();
+
+    for (std::size_t k = 0; k < frames; ++k) {
+        for (unsigned int bin = 0; bin < fft_length_; ++bin) {
+            float const re = spec[(k * fft_length_ + bin) * 2];
+            float const im = spec[(k * fft_length_ + bin) * 2 + 1];
+            float const power = re*re + im*im;
+
+            channel.sum_[bin] += power;
+            channel.max_[bin] = std::max(channel.max_[bin], power);
+            channel.occupied_[bin] += power >= threshold_ ? 1 : 0;
+        }
+    }
+
+    channel.frames_ += frames;
+}
+
+void Scanner::queueReport(void)
+{
+    ++passes_;
+
+    auto const now = std::chrono::steady_clock::now();
+    float const seconds = std::chrono::duration<float>(now - pass_start_).count();
+    pass_start_ = now;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        // Reuses the vectors of the snapshot the writer handed back
+        pending_ = channels_;
+        pending_passes_ = passes_;
+        pending_seconds_ = seconds;
+        report_pending_ = true;
+    }
+
+    cv_.notify_one();
+}
+
+void Scanner::writerLoop(void)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        cv_.wait(lock, [this] { return report_pending_ || ! writing_; });
+
+        if (! report_pending_) {
+            break;
+        }
+
+        std::swap(pending_, report_);
+        report_passes_ = pending_passes_;
+        report_seconds_ = pending_seconds_;
+        report_pending_ = false;
+        lock.unlock();
+
+        writeReport();
+
+        lock.lock();
+    }
+}
+
+void Scanner::writeReport(void)
+{
+    std::ofstream report{report_path_, std::ios::trunc};
+
+    if (! report) {
+        std::cerr << fmt::format("Failed to write scan report {}", report_path_) << std::endl;
+        return;
+    }
+
+    report << "frequency_hz,mean_db,max_db,occupancy\n";
+
+    float const bin_width = static_cast<float>(sample_rate_) / fft_length_;
+
+    for (auto const& channel : report_) {
+        for (unsigned int bin = 0; bin < fft_length_; ++bin) {
+            double const mean = channel.frames_ ? channel.sum_[bin] / channel.frames_ : 0.0;
+            double const occupancy = channel.frames_ ? static_cast<double>(channel.occupied_[bin]) / channel.frames_ : 0.0;
+            auto const freq = static_cast<long long>(channel.frequency_) + static_cast<long long>((static_cast<int>(bin) - static_cast<int>(fft_length_ / 2)) * bin_width);
+
+            report << fmt::format(
+                "{},{:.1f},{:.1f},{:.4f}\n",
+                freq,
+                10.0 * std::log10(std::max(mean, 1e-20)),
+                10.f * std::log10(std::max(channel.max_[bin], 1e-20f)),
+                occupancy
+            );
+        }
+    }
+
+    std::cout << fmt::format(
+        "Scan pass {}: {} channels in {:.1f} s ({:.0f} channels/min), report written to {}",
+        report_passes_,
+        report_.size(),
+        report_seconds_,
+        report_.size() * 60.f / report_seconds_,
+        report_path_
+    ) << std::endl;
+}
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_SCANNER_HPP
+#define JDRADIO_SCANNER_HPP
+
+#include "SampleSource.hpp"
+#include "FFT.hpp"
+#include "DwellSequencer.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//! Steps the source across a list of channels and accumulates per-bin
+//! occupancy statistics for a site survey.
+//!
+//! Retuning runs through a DwellSequencer. When a dwell is complete the next
+//! retune is requested first, then the captured dwell is analyzed on the
+//! stream thread while the tuner settles, since those samples are discarded.
+//! After every full pass, the statistics are copied for a writer thread that
+//! rewrites the report file; a pass finishing before the previous one is
+//! written replaces it, as the statistics are cumulative.
+class Scanner
+{
+public:
+    Scanner(void) noexcept;
+    ~Scanner(void) noexcept;
+
+    void setChannels(std::vector<unsigned int> const& frequencies);
+    void setRange(unsigned int start, unsigned int stop, unsigned int step);
+    void setDwellTime(std::chrono::milliseconds dwell);
+    void setSettleTime(std::chrono::milliseconds settle);
+    void setFFTLength(unsigned int len);
+    void setThreshold(float db);
+    void setReportPath(std::string const& path);
+
+    bool start(SampleSource& source, unsigned int sample_rate);
+    void stop(void) noexcept;
+    void onSamples(std::vector<std::uint8_t> const& in);
+
+private:
+    struct Channel
+    {
+        unsigned int frequency_;
+        std::uint64_t frames_;
+        std::vector<double> sum_;
+        std::vector<float> max_;
+        std::vector<std::uint32_t> occupied_;
+    };
+
+    void processDwell(Channel& channel, std::vector<std::uint8_t> const& dwell);
+    void queueReport(void);
+    void writerLoop(void);
+    void writeReport(void);
+
+    std::vector<Channel> channels_;
+    std::chrono::milliseconds dwell_time_;
+    std::chrono::milliseconds settle_time_;
+    unsigned int fft_length_;
+    float threshold_;
+    std::string report_path_;
+
+    SampleSource* source_;
+    unsigned int sample_rate_;
+    FFT fft_;
+    DwellSequencer sequencer_;
+    unsigned int current_;
+    std::vector<float> samples_;
+    std::vector<float> spectrum_;
+    unsigned int passes_;
+    std::chrono::steady_clock::time_point pass_start_;
+    bool running_;
+
+    //! Latest pass waiting for the writer, which swaps it with report_
+    std::vector<Channel> pending_;
+    unsigned int pending_passes_;
+    float pending_seconds_;
+    bool report_pending_;
+    std::vector<Channel> report_;
+    unsigned int report_passes_;
+    float report_seconds_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread writer_;
+    bool writing_;
+};
+
+#endif
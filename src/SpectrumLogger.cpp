@@ -0,0 +1,379 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "SpectrumLogger.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+#include <fmt/format.h>
+#include <zlib.h>
+
+static std::string formatCompactDateTime(std::chrono::system_clock::time_point tp)
+{
+    auto const secs = std::chrono::system_clock::to_time_t(tp);
+    std::tm t{};
+    gmtime_r(&secs, &t);
+
+    return fmt::format("{:04}{:02}{:02}T{:02}{:02}{:02}Z", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+}
+
+static void putBigEndian(std::vector<std::uint8_t>& out, std::uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static void appendChunk(std::vector<std::uint8_t>& out, char const* type, std::uint8_t const* data, std::size_t size)
+{
+    putBigEndian(out, size);
+    std::size_t const start = out.size();
+    out.insert(std::end(out), type, type + 4);
+    out.insert(std::end(out), data, data + size);
+    putBigEndian(out, crc32(0, out.data() + start, size + 4));
+}
+
+SpectrumLogger::SpectrumLogger(void) noexcept :
+    directory_{"."},
+    format_{Format::PNG},
+    rows_per_tile_{1024},
+    backlog_length_{64},
+    min_db_{-130.f},
+    max_db_{0.f},
+    thresholds_{},
+    colormap_{},
+    frequency_{0},
+    span_{0},
+    bin_count_{0},
+    slots_{},
+    free_rows_{},
+    full_rows_{},
+    dropped_rows_{0},
+    mutex_{},
+    cv_{},
+    writer_{},
+    running_{false},
+    tile_{},
+    tile_times_{},
+    tile_index_{0}
+{
+    setLevels(min_db_, max_db_);
+
+    // Black through violet, red and orange to pale yellow
+    static constexpr std::uint8_t anchors[][4] = {
+        {0, 0, 0, 0},
+        {64, 40, 0, 120},
+        {128, 190, 30, 80},
+        {192, 250, 140, 10},
+        {255, 255, 255, 200},
+    };
+
+    for (unsigned int n = 0; n < 4; ++n) {
+        auto const* lo = anchors[n];
+        auto const* hi = anchors[n + 1];
+
+        for (unsigned int idx = lo[0]; idx <= hi[0]; ++idx) {
+            float const t = static_cast<float>(idx - lo[0]) / (hi[0] - lo[0]);
+
+            for (unsigned int c = 0; c < 3; ++c) {
+                colormap_[idx][c] = static_cast<std::uint8_t>(lo[c + 1] + t * (hi[c + 1] - lo[c + 1]) + 0.5f);
+            }
+        }
+    }
+}
+
+SpectrumLogger::~SpectrumLogger(void) noexcept
+{
+    stop();
+}
+
+void SpectrumLogger::setDirectory(std::string const& dir)
+{
+    directory_ = dir;
+}
+
+void SpectrumLogger::setFormat(Format format)
+{
+    format_ = format;
+}
+
+void SpectrumLogger::setRowsPerTile(unsigned int rows)
+{
+    rows_per_tile_ = std::max(1U, rows);
+}
+
+void SpectrumLogger::setBacklogLength(unsigned int rows)
+{
+    backlog_length_ = std::max(2U, rows);
+}
+
+void SpectrumLogger::setLevels(float min_db, float max_db)
+{
+    min_db_ = min_db;
+    max_db_ = std::max(max_db, min_db + 1.f);
+
+    float const step_db = (max_db_ - min_db_) / 255.f;
+
+    // Level n covers the powers between thresholds_[n - 1] and thresholds_[n]
+    for (unsigned int n = 0; n < thresholds_.size(); ++n) {
+        thresholds_[n] = std::pow(10.f, (min_db_ + (n + 0.5f) * step_db) / 10.f);
+    }
+}
+
+bool SpectrumLogger::start(unsigned int frequency, unsigned int sample_rate, unsigned int bin_count)
+{
+    if (running_ || bin_count == 0) {
+        return false;
+    }
+
+    frequency_ = frequency;
+    span_ = sample_rate;
+    bin_count_ = bin_count;
+
+    slots_.assign(static_cast<std::size_t>(backlog_length_) * bin_count_, 0);
+    free_rows_.clear();
+    full_rows_.clear();
+    free_rows_.reserve(backlog_length_);
+    full_rows_.reserve(backlog_length_);
+
+    for (unsigned int n = 0; n < backlog_length_; ++n) {
+        free_rows_.push_back(Row{static_cast<std::size_t>(n) * bin_count_, {}, 0, 0});
+    }
+
+    tile_.clear();
+    tile_.reserve(static_cast<std::size_t>(rows_per_tile_) * bin_count_);
+    tile_times_.clear();
+    tile_times_.reserve(rows_per_tile_);
+    dropped_rows_ = 0;
+    running_ = true;
+
+    try {
+        writer_ = std::thread{&SpectrumLogger::writerLoop, this};
+    }
+    catch (std::system_error const&) {
+        std::cerr << "Failed to start spectrum logger thread" << std::endl;
+        running_ = false;
+        return false;
+    }
+
+    return true;
+}
+
+void SpectrumLogger::stop(void) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    cv_.notify_one();
+
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void SpectrumLogger::onSpectrum(unsigned int frequency, unsigned int span, std::vector<float> const& bin_power) noexcept
+{
+    if (bin_power.size() != bin_count_) {
+        return;
+    }
+
+    Row row;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        if (free_rows_.empty()) {
+            ++dropped_rows_;
+            return;
+        }
+
+        row = free_rows_.back();
+        free_rows_.pop_back();
+    }
+
+    row.time_ = std::chrono::system_clock::now();
+    row.frequency_ = frequency;
+    row.span_ = span;
+
+    // The slot belongs to this thread until it is queued, so it is filled unlocked
+    auto* out = slots_.data() + row.slot_;
+    auto const first = std::begin(thresholds_);
+    auto const last = std::end(thresholds_);
+
+    for (unsigned int n = 0; n < bin_count_; ++n) {
+        out[n] = static_cast<std::uint8_t>(std::upper_bound(first, last, bin_power[n]) - first);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        full_rows_.push_back(row);
+    }
+
+    cv_.notify_one();
+}
+
+std::uint64_t SpectrumLogger::droppedRows(void) const noexcept
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return dropped_rows_;
+}
+
+void SpectrumLogger::writerLoop(void)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        cv_.wait(lock, [this] { return ! full_rows_.empty() || ! running_; });
+
+        if (full_rows_.empty()) {
+            break;
+        }
+
+        Row row = full_rows_.front();
+        full_rows_.erase(std::begin(full_rows_));
+        lock.unlock();
+
+        // Rows of another center or span would not match the tile's index
+        if (! tile_times_.empty() && (row.frequency_ != frequency_ || row.span_ != span_)) {
+            writeTile();
+        }
+
+        frequency_ = row.frequency_;
+        span_ = row.span_;
+
+        auto const* data = slots_.data() + row.slot_;
+        tile_.insert(std::end(tile_), data, data + bin_count_);
+        tile_times_.push_back(row.time_);
+
+        if (tile_times_.size() == rows_per_tile_) {
+            writeTile();
+        }
+
+        lock.lock();
+        free_rows_.push_back(row);
+    }
+
+    lock.unlock();
+
+    // A partial tile is written with the rows it has
+    if (! tile_times_.empty()) {
+        writeTile();
+    }
+}
+
+void SpectrumLogger::writeTile(void)
+{
+    auto const base = fmt::format("{}/arcal-spectrum-{}-{:04}", directory_, formatCompactDateTime(tile_times_.front()), tile_index_++);
+    auto const path = base + (format_ == Format::PNG ? ".png" : ".pgm");
+    bool const ok = format_ == Format::PNG ? writePNG(path) : writePGM(path);
+
+    if (ok) {
+        writeIndex(base + ".idx");
+    }
+    else {
+        std::cerr << fmt::format("Failed to write spectrum tile {}", path) << std::endl;
+    }
+
+    tile_.clear();
+    tile_times_.clear();
+}
+
+bool SpectrumLogger::writePGM(std::string const& path)
+{
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+
+    out << fmt::format("P5\n{} {}\n255\n", bin_count_, tile_times_.size());
+    out.write(reinterpret_cast<char const*>(tile_.data()), tile_.size());
+
+    return static_cast<bool>(out);
+}
+
+bool SpectrumLogger::writePNG(std::string const& path)
+{
+    std::uint32_t const width = bin_count_;
+    std::uint32_t const height = tile_times_.size();
+
+    // Consecutive rows are close to each other, so the Up filter leaves mostly zeros
+    std::vector<std::uint8_t> raw(static_cast<std::size_t>(width + 1) * height);
+
+    for (std::uint32_t y = 0; y < height; ++y) {
+        auto* dst = raw.data() + static_cast<std::size_t>(y) * (width + 1);
+        auto const* src = tile_.data() + static_cast<std::size_t>(y) * width;
+        dst[0] = y > 0 ? 2 : 0;
+
+        if (y == 0) {
+            std::memcpy(dst + 1, src, width);
+            continue;
+        }
+
+        auto const* prev = src - width;
+
+        for (std::uint32_t x = 0; x < width; ++x) {
+            dst[x + 1] = static_cast<std::uint8_t>(src[x] - prev[x]);
+        }
+    }
+
+    uLongf packed_size = compressBound(raw.size());
+    std::vector<std::uint8_t> packed(packed_size);
+
+    if (compress2(packed.data(), &packed_size, raw.data(), raw.size(), 6) != Z_OK) {
+        return false;
+    }
+
+    std::vector<std::uint8_t> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    // 8-bit indexed color, default compression, filter and interlace methods
+    header.insert(std::end(header), {8, 3, 0, 0, 0});
+
+    std::vector<std::uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    png.reserve(packed_size + 1024);
+    appendChunk(png, "IHDR", header.data(), header.size());
+    appendChunk(png, "PLTE", colormap_[0].data(), colormap_.size() * 3);
+    appendChunk(png, "IDAT", packed.data(), packed_size);
+    appendChunk(png, "IEND", nullptr, 0);
+
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<char const*>(png.data()), png.size());
+
+    return static_cast<bool>(out);
+}
+
+void SpectrumLogger::writeIndex(std::string const& path)
+{
+    std::ofstream idx{path, std::ios::trunc};
+
+    if (! idx) {
+        std::cerr << fmt::format("Failed to write spectrum index {}", path) << std::endl;
+        return;
+    }
+
+    idx << fmt::format("# frequency {}\n", frequency_);
+    idx << fmt::format("# bin_width {}\n", static_cast<float>(span_) / bin_count_);
+    idx << fmt::format("# level_db = {} + value * {}\n", min_db_, (max_db_ - min_db_) / 255.f);
+    idx << "# row timestamp_ns\n";
+
+    for (unsigned int n = 0; n < tile_times_.size(); ++n) {
+        auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tile_times_[n].time_since_epoch()).count();
+        idx << fmt::format("{} {}\n", n, ns);
+    }
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_SPECTRUMLOGGER_HPP
+#define JDRADIO_SPECTRUMLOGGER_HPP
+
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//! Logs averaged spectrum rows to image tiles for long-term review.
+//!
+//! Each row is quantized to 8 bits on the caller's thread with a table of
+//! precomputed power thresholds, so no logarithm is taken per bin. Rows are
+//! handed to a writer thread through a fixed set of slots; when every slot is
+//! in use the row is dropped rather than blocking detection.
+//!
+//! Every tile holds up to rows_per_tile rows, oldest at the top, and is written
+//! as an 8-bit PGM or as a PNG using the colormap as its palette. Next to each
+//! tile, a .idx text file gives the levels and the timestamp of every row.
+//! Rows carry the center and span they were computed for, and a change, such
+//! as a waterfall zoom, starts a new tile so each index describes all its rows.
+class SpectrumLogger
+{
+public:
+    enum class Format
+    {
+        PGM,
+        PNG,
+    };
+
+    SpectrumLogger(void) noexcept;
+    ~SpectrumLogger(void) noexcept;
+
+    void setDirectory(std::string const& dir);
+    void setFormat(Format format);
+    void setRowsPerTile(unsigned int rows);
+    void setBacklogLength(unsigned int rows);
+    void setLevels(float min_db, float max_db);
+
+    bool start(unsigned int frequency, unsigned int sample_rate, unsigned int bin_count);
+    void stop(void) noexcept;
+    void onSpectrum(unsigned int frequency, unsigned int span, std::vector<float> const& bin_power) noexcept;
+    std::uint64_t droppedRows(void) const noexcept;
+
+private:
+    struct Row
+    {
+        std::size_t slot_;
+        std::chrono::system_clock::time_point time_;
+        unsigned int frequency_;
+        unsigned int span_;
+    };
+
+    void writerLoop(void);
+    void writeTile(void);
+    bool writePGM(std::string const& path);
+    bool writePNG(std::string const& path);
+    void writeIndex(std::string const& path);
+
+    std::string directory_;
+    Format format_;
+    unsigned int rows_per_tile_;
+    unsigned int backlog_length_;
+    float min_db_;
+    float max_db_;
+    std::array<float, 255> thresholds_;
+    std::array<std::array<std::uint8_t, 3>, 256> colormap_;
+
+    //! Center and span of the tile being built
+    unsigned int frequency_;
+    unsigned int span_;
+    unsigned int bin_count_;
+    std::vector<std::uint8_t> slots_;
+    std::vector<Row> free_rows_;
+    std::vector<Row> full_rows_;
+    std::uint64_t dropped_rows_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread writer_;
+    bool running_;
+
+    std::vector<std::uint8_t> tile_;
+    std::vector<std::chrono::system_clock::time_point> tile_times_;
+    unsigned int tile_index_;
+};
+
+#endif
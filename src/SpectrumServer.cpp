@@ -0,0 +1,396 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "SpectrumServer.hpp"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <system_error>
+#include <fmt/format.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static constexpr std::uint32_t FRAME_MAGIC = 0x50535241; // "ARSP"
+static constexpr std::uint16_t FRAME_VERSION = 1;
+static constexpr std::size_t FRAME_HEADER_SIZE = 40;
+
+template<class T>
+static std::uint8_t* put(std::uint8_t* ptr, T value)
+{
+    std::memcpy(ptr, &value, sizeof(T));
+    return ptr + sizeof(T);
+}
+
+SpectrumServer::SpectrumServer(void) noexcept :
+    unix_path_{},
+    tcp_address_{},
+    tcp_port_{0},
+    format_{Format::UInt8},
+    min_db_{-130.f},
+    max_db_{0.f},
+    client_buffer_size_{256U << 10},
+    listen_fds_{},
+    wake_fd_{-1},
+    clients_{},
+    frame_{},
+    mutex_{},
+    thread_{},
+    running_{false}
+{
+}
+
+SpectrumServer::~SpectrumServer(void) noexcept
+{
+    stop();
+}
+
+void SpectrumServer::setUnixPath(std::string const& path)
+{
+    unix_path_ = path;
+}
+
+void SpectrumServer::setTcpPort(std::string const& address, unsigned short port)
+{
+    tcp_address_ = address;
+    tcp_port_ = port;
+}
+
+void SpectrumServer::setFormat(Format format, float min_db, float max_db)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    format_ = format;
+    min_db_ = min_db;
+    max_db_ = std::max(max_db, min_db + 1.f);
+}
+
+void SpectrumServer::setClientBufferSize(std::size_t size)
+{
+    client_buffer_size_ = size;
+}
+
+bool SpectrumServer::start(unsigned int bin_count)
+{
+    if (running_) {
+        return false;
+    }
+
+    if (! unix_path_.empty()) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, unix_path_.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(unix_path_.c_str());
+
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, 8) < 0) {
+            std::cerr << fmt::format("Failed to listen on {}: {}", unix_path_, std::strerror(errno)) << std::endl;
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            closeAll();
+            return false;
+        }
+
+        listen_fds_.push_back(fd);
+    }
+
+    if (tcp_port_ != 0) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(tcp_port_);
+
+        bool ok = fd >= 0 &&
+            ::inet_pton(AF_INET, tcp_address_.c_str(), &addr.sin_addr) == 1 &&
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+            ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+            ::listen(fd, 8) == 0;
+
+        if (! ok) {
+            std::cerr << fmt::format("Failed to listen on {}:{}: {}", tcp_address_, tcp_port_, std::strerror(errno)) << std::endl;
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            closeAll();
+            return false;
+        }
+
+        listen_fds_.push_back(fd);
+    }
+
+    if (listen_fds_.empty()) {
+        std::cerr << "Spectrum server has no socket configured" << std::endl;
+        return false;
+    }
+
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (wake_fd_ < 0) {
+        closeAll();
+        return false;
+    }
+
+    // publish() is noexcept, so the largest frame it builds is allocated here
+    frame_.reserve(FRAME_HEADER_SIZE + bin_count * sizeof(float));
+    running_ = true;
+
+    try {
+        thread_ = std::thread{&SpectrumServer::serverLoop, this};
+    }
+    catch (std::system_error const&) {
+        running_ = false;
+        closeAll();
+        return false;
+    }
+
+    return true;
+}
+
+void SpectrumServer::stop(void) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_) {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    std::uint64_t one = 1;
+
+    if (::write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        std::cerr << fmt::format("Failed to wake spectrum server: {}", std::strerror(errno)) << std::endl;
+    }
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    closeAll();
+}
+
+void SpectrumServer::publish(unsigned int frequency, unsigned int sample_rate, std::vector<float> const& bin_power) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        if (! running_ || clients_.empty()) {
+            return;
+        }
+
+        std::uint32_t const bin_count = bin_power.size();
+        std::size_t const bin_size = format_ == Format::UInt8 ? 1 : 4;
+        std::size_t const frame_size = FRAME_HEADER_SIZE + bin_count * bin_size;
+        float const step_db = (max_db_ - min_db_) / 255.f;
+
+        // Wider than start() allowed for, growing the frame could throw
+        if (frame_size > frame_.capacity()) {
+            return;
+        }
+
+        frame_.resize(frame_size);
+
+        auto const now = std::chrono::system_clock::now().time_since_epoch();
+        auto* ptr = frame_.data();
+        ptr = put(ptr, FRAME_MAGIC);
+        ptr = put(ptr, FRAME_VERSION);
+        ptr = put(ptr, static_cast<std::uint16_t>(format_));
+        ptr = put(ptr, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+        ptr = put(ptr, static_cast<std::uint64_t>(frequency));
+        ptr = put(ptr, static_cast<float>(sample_rate) / static_cast<float>(bin_count));
+        ptr = put(ptr, bin_count);
+        ptr = put(ptr, min_db_);
+        ptr = put(ptr, step_db);
+
+        for (auto const& pwr : bin_power) {
+            float const db = 10.f * std::log10(std::max(pwr, 1e-20f));
+
+            if (format_ == Format::UInt8) {
+                float const q = (db - min_db_) / step_db + 0.5f;
+                *ptr++ = static_cast<std::uint8_t>(std::min(std::max(q, 0.f), 255.f));
+            }
+            else {
+                ptr = put(ptr, db);
+            }
+        }
+
+        for (auto& client : clients_) {
+            std::size_t const size = client.ring_.size();
+
+            if (size - client.used_ < frame_size) {
+                ++client.dropped_frames_;
+                continue;
+            }
+
+            std::size_t const tail = (client.head_ + client.used_) % size;
+            std::size_t const first = std::min(frame_size, size - tail);
+            std::memcpy(client.ring_.data() + tail, frame_.data(), first);
+            std::memcpy(client.ring_.data(), frame_.data() + first, frame_size - first);
+            client.used_ += frame_size;
+        }
+    }
+
+    std::uint64_t one = 1;
+
+    // EAGAIN only means the counter is saturated, and the server is awake anyway
+    if (::write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        std::cerr << fmt::format("Failed to wake spectrum server: {}", std::strerror(errno)) << std::endl;
+    }
+}
+
+void SpectrumServer::serverLoop(void)
+{
+    std::vector<pollfd> fds;
+
+    for (;;) {
+        fds.clear();
+        fds.push_back(pollfd{wake_fd_, POLLIN, 0});
+
+        for (auto fd : listen_fds_) {
+            fds.push_back(pollfd{fd, POLLIN, 0});
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+
+            if (! running_) {
+                break;
+            }
+
+            for (auto const& client : clients_) {
+                fds.push_back(pollfd{client.fd_, static_cast<short>(POLLIN | (client.used_ > 0 ? POLLOUT : 0)), 0});
+            }
+        }
+
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            std::cerr << fmt::format("Spectrum server poll failed: {}", std::strerror(errno)) << std::endl;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            std::uint64_t count = 0;
+
+            if (::read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                std::cerr << fmt::format("Failed to clear spectrum server wakeup: {}", std::strerror(errno)) << std::endl;
+            }
+        }
+
+        for (unsigned int n = 0; n < listen_fds_.size(); ++n) {
+            if (fds[n + 1].revents & POLLIN) {
+                acceptClient(listen_fds_[n]);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::size_t const first_client = listen_fds_.size() + 1;
+
+        // Clients accepted in this pass have no pollfd yet, so only walk the polled ones
+        for (std::size_t n = first_client; n < fds.size(); ++n) {
+            auto& client = clients_[n - first_client];
+            bool keep = true;
+
+            if (fds[n].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                keep = false;
+            }
+            else if (fds[n].revents & POLLIN) {
+                // Clients have nothing to say; anything they send is discarded
+                std::uint8_t discard[256];
+                ssize_t result = ::recv(client.fd_, discard, sizeof(discard), MSG_DONTWAIT);
+                keep = result > 0 || (result < 0 && (errno == EAGAIN || errno == EINTR));
+            }
+
+            if (keep) {
+                keep = flushClient(client);
+            }
+
+            if (! keep) {
+                ::close(client.fd_);
+                client.fd_ = -1;
+            }
+        }
+
+        clients_.erase(
+            std::remove_if(std::begin(clients_), std::end(clients_), [] (auto const& c) { return c.fd_ < 0; }),
+            std::end(clients_)
+        );
+    }
+}
+
+void SpectrumServer::acceptClient(int listen_fd)
+{
+    int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    clients_.push_back(Client{fd, std::vector<std::uint8_t>(client_buffer_size_), 0, 0, 0});
+}
+
+bool SpectrumServer::flushClient(Client& client)
+{
+    std::size_t const size = client.ring_.size();
+
+    while (client.used_ > 0) {
+        std::size_t const chunk = std::min(client.used_, size - client.head_);
+        ssize_t result = ::send(client.fd_, client.ring_.data() + client.head_, chunk, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        client.head_ = (client.head_ + result) % size;
+        client.used_ -= result;
+    }
+
+    return true;
+}
+
+void SpectrumServer::closeAll(void) noexcept
+{
+    for (auto const& client : clients_) {
+        ::close(client.fd_);
+    }
+
+    for (auto fd : listen_fds_) {
+        ::close(fd);
+    }
+
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+
+    if (! unix_path_.empty()) {
+        ::unlink(unix_path_.c_str());
+    }
+
+    clients_.clear();
+    listen_fds_.clear();
+    wake_fd_ = -1;
+}
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_SPECTRUMSERVER_HPP
+#define JDRADIO_SPECTRUMSERVER_HPP
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+
+//! Publishes spectrum rows as binary frames to local socket clients.
+//!
+//! Every frame starts with a 40-byte header in host byte order:
+//!
+//!     uint32 magic        'ARSP'
+//!     uint16 version      1
+//!     uint16 format       0 = uint8 bins, 1 = float32 bins (dBFS)
+//!     uint64 timestamp    nanoseconds since the UNIX epoch
+//!     uint64 frequency    center frequency in Hz
+//!     float  bin_width    Hz
+//!     uint32 bin_count
+//!     float  offset_db    uint8 bins: level = offset_db + value * step_db
+//!     float  step_db
+//!
+//! followed by bin_count bins, lowest frequency first. Each client has its own
+//! ring buffer; when a client cannot keep up, frames are dropped for that
+//! client only and publish() never blocks.
+class SpectrumServer
+{
+public:
+    enum class Format : std::uint16_t
+    {
+        UInt8 = 0,
+        Float32 = 1,
+    };
+
+    SpectrumServer(void) noexcept;
+    ~SpectrumServer(void) noexcept;
+
+    void setUnixPath(std::string const& path);
+    void setTcpPort(std::string const& address, unsigned short port);
+    void setFormat(Format format, float min_db, float max_db);
+    void setClientBufferSize(std::size_t size);
+
+    //! bin_count is the widest spectrum publish() will be given
+    bool start(unsigned int bin_count);
+    void stop(void) noexcept;
+    void publish(unsigned int frequency, unsigned int sample_rate, std::vector<float> const& bin_power) noexcept;
+
+private:
+    struct Client
+    {
+        int fd_;
+        std::vector<std::uint8_t> ring_;
+        std::size_t head_;
+        std::size_t used_;
+        std::uint64_t dropped_frames_;
+    };
+
+    void serverLoop(void);
+    void acceptClient(int listen_fd);
+    bool flushClient(Client& client);
+    void closeAll(void) noexcept;
+
+    std::string unix_path_;
+    std::string tcp_address_;
+    unsigned short tcp_port_;
+    Format format_;
+    float min_db_;
+    float max_db_;
+    std::size_t client_buffer_size_;
+
+    std::vector<int> listen_fds_;
+    int wake_fd_;
+    std::vector<Client> clients_;
+    std::vector<std::uint8_t> frame_;
+    std::mutex mutex_;
+    std::thread thread_;
+    bool running_;
+};
+
+#endif
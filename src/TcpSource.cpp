@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "TcpSource.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fmt/format.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+//! rtl_tcp commands, see rtl_tcp.c
+static constexpr std::uint8_t CMD_SET_FREQUENCY = 0x01;
+static constexpr std::uint8_t CMD_SET_SAMPLE_RATE = 0x02;
+static constexpr std::uint8_t CMD_SET_GAIN = 0x04;
+static constexpr std::uint8_t CMD_SET_AGC_MODE = 0x08;
+
+//! Tuner gains in tenths of dB, from librtlsdr, since rtl_tcp only sends their count
+static std::vector<int> tunerGains(std::uint32_t tuner_type)
+{
+    switch (tuner_type) {
+    case 1: // E4000
+        return {-10, 15, 40, 65, 90, 115, 140, 165, 190, 215, 240, 290, 340, 420};
+    case 2: // FC0012
+        return {-99, -40, 71, 179, 192};
+    case 3: // FC0013
+        return {-99, -73, -65, -63, -60, -58, -54, 58, 61, 63, 65, 67, 68, 70, 71, 179, 181, 182, 184, 186, 188, 191, 197};
+    case 4: // FC2580
+        return {0};
+    case 5: // R820T
+    case 6: // R828D
+        return {0, 9, 14, 27, 37, 77, 87, 125, 144, 157, 166, 197, 207, 229, 254, 280, 297, 328, 338, 364, 372, 386, 402, 421, 434, 439, 445, 480, 496};
+    default:
+        return {};
+    }
+}
+
+TcpSource::TcpSource(std::string const& host, unsigned short port, std::size_t buffer_length) :
+    SampleSource{},
+    fd_{-1},
+    tuner_type_{0},
+    gain_count_{0},
+    buffer_length_{buffer_length & ~static_cast<std::size_t>(1)},
+    buffer_{},
+    send_mutex_{},
+    cancelled_{false}
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+
+    int result = ::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+
+    if (result != 0) {
+        throw ConnectException{result};
+    }
+
+    // close() and freeaddrinfo() may change errno, so the failure is kept aside
+    int error = ECONNREFUSED;
+
+    for (auto* ai = res; ai; ai = ai->ai_next) {
+        fd_ = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+
+        if (fd_ < 0) {
+            error = errno;
+            continue;
+        }
+
+        if (::connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+
+        error = errno;
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    ::freeaddrinfo(res);
+
+    if (fd_ < 0) {
+        throw ConnectException{-error};
+    }
+
+    // A deep kernel buffer absorbs processing jitter, and commands must not wait for Nagle
+    int rcvbuf = 4 << 20;
+    int nodelay = 1;
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    // The server greets with "RTL0", the tuner type and the gain count, big-endian
+    timeval timeout{5, 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::uint8_t header[12];
+
+    if (! receive(header, sizeof(header)) || std::memcmp(header, "RTL0", 4) != 0) {
+        ::close(fd_);
+        throw ConnectException{-EPROTO};
+    }
+
+    timeout = timeval{0, 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::uint32_t value = 0;
+    std::memcpy(&value, header + 4, 4);
+    tuner_type_ = ntohl(value);
+    std::memcpy(&value, header + 8, 4);
+    gain_count_ = ntohl(value);
+}
+
+TcpSource::~TcpSource(void) noexcept
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool TcpSource::sendCommand(std::uint8_t command, std::uint32_t param) noexcept
+{
+    std::lock_guard<std::mutex> lock{send_mutex_};
+
+    std::uint8_t packet[5];
+    std::uint32_t const value = htonl(param);
+    packet[0] = command;
+    std::memcpy(packet + 1, &value, 4);
+
+    return ::send(fd_, packet, sizeof(packet), MSG_NOSIGNAL) == sizeof(packet);
+}
+
+bool TcpSource::receive(std::uint8_t* data, std::size_t size) noexcept
+{
+    std::size_t received = 0;
+
+    while (received < size) {
+        ssize_t result = ::recv(fd_, data + received, size - received, MSG_WAITALL);
+
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (result <= 0) {
+            return false;
+        }
+
+        received += result;
+    }
+
+    return true;
+}
+
+bool TcpSource::setCenterFrequency(unsigned int freq) noexcept
+{
+    return sendCommand(CMD_SET_FREQUENCY, freq);
+}
+
+bool TcpSource::setSampleRate(unsigned int rate) noexcept
+{
+    return sendCommand(CMD_SET_SAMPLE_RATE, rate);
+}
+
+bool TcpSource::resetBuffer(void) noexcept
+{
+    // rtl_tcp resets the device buffer itself before streaming
+    return true;
+}
+
+bool TcpSource::setAgcMode(bool on) noexcept
+{
+    return sendCommand(CMD_SET_AGC_MODE, on ? 1 : 0);
+}
+
+bool TcpSource::setGain(float gain) noexcept
+{
+    return sendCommand(CMD_SET_GAIN, static_cast<std::uint32_t>(static_cast<int>(gain * 10.0f + 0.5f)));
+}
+
+std::pair<bool, std::vector<float>> TcpSource::listGains(void) noexcept
+{
+    auto gains = tunerGains(tuner_type_);
+
+    if (gains.empty() || gains.size() != gain_count_) {
+        return std::make_pair(false, std::vector<float>{});
+    }
+
+    std::vector<float> out;
+    for (auto const& x : gains) {
+        out.push_back(static_cast<float>(x) / 10.0f);
+    }
+
+    return std::make_pair(true, out);
+}
+
+bool TcpSource::setBufferLength(std::size_t bytes) noexcept
+{
+    // Whole IQ pairs only; read with each buffer, so it takes effect from the next one
+    buffer_length_ = std::max<std::size_t>(bytes & ~static_cast<std::size_t>(1), 512);
+
+    return true;
+}
+
+bool TcpSource::readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept
+{
+    cancelled_ = false;
+
+    while (! cancelled_) {
+        // Only reallocates if the handler kept the previous buffer
+        buffer_.resize(buffer_length_);
+
+        if (! receive(buffer_.data(), buffer_length_)) {
+            break;
+        }
+
+        handler(std::move(buffer_));
+    }
+
+    if (! cancelled_) {
+        std::cerr << "rtl_tcp stream ended" << std::endl;
+    }
+
+    return cancelled_;
+}
+
+bool TcpSource::cancelAsync(void) noexcept
+{
+    cancelled_ = true;
+
+    // Wakes up the blocked recv(); the connection is not reusable afterwards
+    return ::shutdown(fd_, SHUT_RDWR) == 0;
+}
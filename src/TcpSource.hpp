@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_TCPSOURCE_HPP
+#define JDRADIO_TCPSOURCE_HPP
+
+#include "SampleSource.hpp"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+//! Sample source for a remote rtl_tcp server.
+//!
+//! The stream is received straight into the buffer handed to the handler,
+//! one full buffer per read, and tuning calls become rtl_tcp commands.
+class TcpSource : public SampleSource
+{
+public:
+    struct ConnectException : Exception
+    {
+        ConnectException(int code) noexcept :
+            Exception(code, "Failed to connect to rtl_tcp server")
+        {
+        }
+    };
+
+    TcpSource(std::string const& host, unsigned short port, std::size_t buffer_length = 16 * 32 * 512);
+    ~TcpSource(void) noexcept override;
+
+    bool setCenterFrequency(unsigned int freq) noexcept override;
+    bool setSampleRate(unsigned int rate) noexcept override;
+    bool resetBuffer(void) noexcept override;
+    bool setAgcMode(bool on) noexcept override;
+    bool setGain(float gain) noexcept override;
+    std::pair<bool, std::vector<float>> listGains(void) noexcept override;
+    bool setBufferLength(std::size_t bytes) noexcept override;
+    bool readAsync(std::function<void(std::vector<std::uint8_t>&&)> handler) noexcept override;
+    bool cancelAsync(void) noexcept override;
+
+private:
+    bool sendCommand(std::uint8_t command, std::uint32_t param) noexcept;
+    bool receive(std::uint8_t* data, std::size_t size) noexcept;
+
+    int fd_;
+    std::uint32_t tuner_type_;
+    std::uint32_t gain_count_;
+    std::size_t buffer_length_;
+    std::vector<std::uint8_t> buffer_;
+    std::mutex send_mutex_;
+    std::atomic<bool> cancelled_;
+};
+
+#endif
@@ -6,11 +6,18 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "Waterfall.hpp"
 #include <iostream>
-#include <sstream>
+#include <iterator>
 #include <numeric>
 #include <functional>
+#include <algorithm>
+#include <cmath>
 #include <fmt/format.h>
 
+constexpr unsigned int Waterfall::MAX_ZOOM_DECIMATION;
+
+//! Below this length, handing bins to the other threads costs more than it saves
+static constexpr unsigned int PARALLEL_LENGTH = 8192;
+
 template<class ForwardIt>
 ForwardIt max_element(ForwardIt first, ForwardIt last)
 {
@@ -38,14 +45,27 @@ Waterfall::Waterfall(void) noexcept :
     fft_length_{},
     average_length_{},
     fft_count_{0},
-    averages_{},
+    spectrum_{},
+    sums_{},
+    bin_power_{},
+    row_{},
+    row_parts_{},
+    pool_{},
     reference_level_{},
     scale_{},
     show_timestamp_{true},
     show_max_power_{true},
     show_total_power_{true},
     show_timestamp_every_n_seconds_{5},
-    last_timestamp_{0}
+    last_timestamp_{0},
+    show_text_{true},
+    spectrum_handler_{nullptr},
+    sample_rate_{256'000U},
+    input_length_{0},
+    zoom_{1, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f, 0, 0, {}, {}, {}},
+    pending_zoom_{1, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f, 0, 0, {}, {}, {}},
+    zoom_pending_{false},
+    zoom_mutex_{}
 {
     setFFTLength(256);
     setAverageLength(64);
@@ -59,18 +79,40 @@ void Waterfall::setFFTLength(unsigned int len)
 
     fft_.setLength(fft_length_);
 
-    averages_.clear();
-    averages_.resize(fft_length_);
+    sums_.assign(fft_length_, 0.f);
+    bin_power_.assign(fft_length_, 0.f);
+    reserveRow();
 
     fft_count_ = 0;
 }
 
+void Waterfall::setThreads(unsigned int threads)
+{
+    pool_.setThreads(threads);
+    reserveRow();
+}
+
+void Waterfall::reserveRow(void)
+{
+    // Each bin renders as an escape sequence and a character, plus the timestamp and totals
+    row_.reserve(fft_length_ * 8 + 128);
+    row_parts_.resize(pool_.threads());
+
+    for (auto& part : row_parts_) {
+        part.reserve((fft_length_ / pool_.threads() + 1) * 8);
+    }
+}
+
+unsigned int Waterfall::fftLength(void) const noexcept
+{
+    return fft_length_;
+}
+
 void Waterfall::setAverageLength(unsigned int len)
 {
     average_length_ = len;
 
-    averages_.clear();
-    averages_.resize(fft_length_);
+    sums_.assign(fft_length_, 0.f);
 
     fft_count_ = 0;
 }
@@ -85,6 +127,160 @@ void Waterfall::setScale(float scale)
     scale_ = scale;
 }
 
+void Waterfall::setWindow(FFT::Window window, float overlap)
+{
+    fft_.setWindow(window);
+    fft_.setOverlap(overlap);
+
+    sums_.assign(fft_length_, 0.f);
+    fft_count_ = 0;
+}
+
+void Waterfall::setTextOutput(bool on)
+{
+    show_text_ = on;
+}
+
+void Waterfall::setSpectrumHandler(std::function<void(std::vector<float> const&)> handler)
+{
+    spectrum_handler_ = handler;
+}
+
+void Waterfall::setSampleRate(unsigned int rate)
+{
+    sample_rate_ = rate;
+}
+
+bool Waterfall::setZoom(float offset, float span)
+{
+    // Called from any thread: everything is built here and the DSP thread only swaps it in
+    Zoom zoom{1, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f, 0, 0, {}, {}, {}};
+    unsigned int const decimation = span > 0.f ? static_cast<unsigned int>(sample_rate_ / span) : 1;
+
+    // Keeps the filter to a few thousand taps
+    if (decimation > MAX_ZOOM_DECIMATION) {
+        return false;
+    }
+
+    if (decimation > 1) {
+        float const pi = 3.14159265358979f;
+        // Cut off at 0.4 of the decimated rate, with enough taps for the Blackman
+        // transition to end by 0.6: what aliases then only lands in the outer tenth
+        // on each side of the row, at least 24 dB down, and the rest is clean to 75 dB
+        unsigned int const length = 14 * decimation + 1;
+        float const fc = 0.4f / decimation;
+        float const mid = (length - 1) / 2.f;
+        float sum = 0.f;
+
+        zoom.decimation_ = decimation;
+        zoom.offset_ = offset;
+        zoom.span_ = static_cast<float>(sample_rate_) / decimation;
+        zoom.step_re_ = std::cos(-2.f * pi * offset / sample_rate_);
+        zoom.step_im_ = std::sin(-2.f * pi * offset / sample_rate_);
+        zoom.taps_.resize(length);
+
+        for (unsigned int n = 0; n < length; ++n) {
+            float const x = n - mid;
+            float const sinc = x == 0.f ? 2.f * fc : std::sin(2.f * pi * fc * x) / (pi * x);
+            zoom.taps_[n] = sinc * (0.42f - 0.5f * std::cos(2.f * pi * n / (length - 1)) + 0.08f * std::cos(4.f * pi * n / (length - 1)));
+            sum += zoom.taps_[n];
+        }
+
+        for (auto& tap : zoom.taps_) {
+            tap /= sum;
+        }
+
+        // Twice the filter length, so the window is always contiguous
+        zoom.history_.assign(length * 4, 0.f);
+        zoom.output_.reserve((input_length_ / 2 / decimation + 1) * 2);
+    }
+
+    std::lock_guard<std::mutex> lock{zoom_mutex_};
+    pending_zoom_ = std::move(zoom);
+    zoom_pending_ = true;
+
+    return true;
+}
+
+float Waterfall::centerOffset(void) const noexcept
+{
+    return zoom_.offset_;
+}
+
+float Waterfall::span(void) const noexcept
+{
+    return zoom_.decimation_ > 1 ? zoom_.span_ : static_cast<float>(sample_rate_);
+}
+
+void Waterfall::applyZoom(void)
+{
+    {
+        std::lock_guard<std::mutex> lock{zoom_mutex_};
+        // The previous settings are released by the next setZoom(), not on this thread
+        std::swap(zoom_, pending_zoom_);
+        zoom_pending_ = false;
+    }
+
+    // Frames from the old span must not be averaged with the new one
+    std::fill(std::begin(sums_), std::end(sums_), 0.f);
+    fft_count_ = 0;
+    fft_.skip(0);
+}
+
+void Waterfall::zoomSamples(std::vector<float> const& samples)
+{
+    unsigned int const in_size = samples.size() & ~1U;
+    unsigned int const length = zoom_.taps_.size();
+    unsigned int const decimation = zoom_.decimation_;
+    float const* taps = zoom_.taps_.data();
+    float* hist = zoom_.history_.data();
+    float phasor_re = zoom_.phasor_re_;
+    float phasor_im = zoom_.phasor_im_;
+
+    // Keeps the capacity from previous buffers
+    zoom_.output_.clear();
+
+    for (unsigned int n = 0; n < in_size; n += 2) {
+        // Shift the selected offset down to DC
+        float const re = samples[n] * phasor_re - samples[n+1] * phasor_im;
+        float const im = samples[n] * phasor_im + samples[n+1] * phasor_re;
+        float const next_re = phasor_re * zoom_.step_re_ - phasor_im * zoom_.step_im_;
+        phasor_im = phasor_re * zoom_.step_im_ + phasor_im * zoom_.step_re_;
+        phasor_re = next_re;
+
+        unsigned int const head = zoom_.head_;
+        hist[head*2] = re;
+        hist[head*2+1] = im;
+        hist[(head+length)*2] = re;
+        hist[(head+length)*2+1] = im;
+        zoom_.head_ = head + 1 == length ? 0 : head + 1;
+
+        if (++zoom_.phase_ < decimation) {
+            continue;
+        }
+
+        zoom_.phase_ = 0;
+
+        // The FIR is only evaluated for the samples that survive decimation
+        float const* window = hist + zoom_.head_ * 2;
+        float acc_re = 0.f;
+        float acc_im = 0.f;
+
+        for (unsigned int k = 0; k < length; ++k) {
+            acc_re += taps[k] * window[k*2];
+            acc_im += taps[k] * window[k*2+1];
+        }
+
+        zoom_.output_.push_back(acc_re);
+        zoom_.output_.push_back(acc_im);
+    }
+
+    // Keeps rounding errors from growing the phasor over a long run
+    float const magnitude = std::sqrt(phasor_re * phasor_re + phasor_im * phasor_im);
+    zoom_.phasor_re_ = phasor_re / magnitude;
+    zoom_.phasor_im_ = phasor_im / magnitude;
+}
+
 unsigned int Waterfall::mapPowerLevel(float lvl, float in_min, float in_max, unsigned int out_min, unsigned int out_max)
 {
     if (lvl >= in_max) {
@@ -126,84 +322,145 @@ int Waterfall::getWeightColor(float val)
     return color_lo_hi[mapPowerLevel(clamp(val, 0.f, scale_ * 9), 0.f, scale_ * 9, 0, 9)];
 }
 
-std::string Waterfall::getWeightColorString(float val)
+void Waterfall::appendWeightColorString(std::string& out, float val)
 {
-    return fmt::format("\033[0;{}m{}", getWeightColor(val), getWeightCharacter(val));
+    fmt::format_to(std::back_inserter(out), "\033[0;{}m{}", getWeightColor(val), getWeightCharacter(val));
 }
 
-void Waterfall::pushToAverage(unsigned int index, float val)
+void Waterfall::accumulateBins(float const* frames, unsigned int count, unsigned int average, bool complete, unsigned int first, unsigned int last)
 {
-    auto& vec = averages_[index];
-    vec.push_back(val);
+    for (unsigned int f = 0; f < count; ++f) {
+        float const* spec = frames + f * fft_length_ * 2;
+
+        for (unsigned int n = first; n < last; ++n) {
+            sums_[n] += spec[n*2]*spec[n*2] + spec[n*2+1]*spec[n*2+1];
+        }
+    }
+
+    if (complete) {
+        for (unsigned int n = first; n < last; ++n) {
+            bin_power_[n] = sums_[n] / static_cast<float>(average);
+            sums_[n] = 0.f;
+        }
+    }
 }
 
 void Waterfall::calculateFFT(std::vector<float> const& samples)
 {
-    auto spec = fft_.execute(samples);
-    unsigned int const spec_size = spec.size();
+    fft_.execute(samples, spectrum_);
+    unsigned int const frames = spectrum_.size() / (fft_length_ * 2);
+    // Zoomed frames come in slower by the decimation, so fewer are averaged to keep the row rate
+    unsigned int const average = std::max(1U, average_length_ / zoom_.decimation_);
+    unsigned int frame = 0;
+
+    while (frame < frames) {
+        // Every frame up to the end of the current average goes in one pass over the bins
+        unsigned int const count = std::min(frames - frame, average > fft_count_ ? average - fft_count_ : 1U);
+        float const* first_frame = spectrum_.data() + frame * fft_length_ * 2;
+        bool const complete = fft_count_ + count >= average;
+
+        auto accumulate = [&] (unsigned int, unsigned int first, unsigned int last) {
+            accumulateBins(first_frame, count, average, complete, first, last);
+        };
+
+        if (fft_length_ >= PARALLEL_LENGTH) {
+            pool_.run(fft_length_, accumulate);
+        }
+        else {
+            accumulate(0, 0, fft_length_);
+        }
 
-    for (unsigned int i = 0; i < spec_size; i += 2) {
-        if (i % (fft_length_ * 2) == 0) {
-            ++fft_count_;
+        frame += count;
+        fft_count_ += count;
+
+        if (complete) {
+            fft_count_ = 0;
+            displayFFT();
         }
+    }
+}
 
-        pushToAverage((i/2) % fft_length_, spec[i]*spec[i] + spec[i+1]*spec[i+1]);
+void Waterfall::renderBins(std::string& out, unsigned int first, unsigned int last)
+{
+    for (unsigned int i = first; i < last; ++i) {
+        appendWeightColorString(out, 10.f * std::log10(bin_power_[i]) - reference_level_);
     }
 }
 
 void Waterfall::displayFFT(void)
 {
-    while (fft_count_ >= average_length_) {
-        fft_count_ -= average_length_;
-
-        std::stringstream sb;
+    if (spectrum_handler_) {
+        spectrum_handler_(bin_power_);
+    }
 
-        std::vector<float> bin_power(fft_length_);
+    if (! show_text_) {
+        return;
+    }
 
-        for (unsigned int i = 0; i < fft_length_; ++i) {
-            auto& vec = averages_[i];
-            float pwr = std::accumulate(std::begin(vec), std::begin(vec) + average_length_, 0.f) / static_cast<float>(average_length_);
-            bin_power[i] = pwr;
-            vec.erase(std::begin(vec), std::begin(vec) + average_length_);
-            sb << getWeightColorString(10.f * std::log10(pwr) - reference_level_);
+    // row_ keeps its capacity between rows, so formatting does not allocate
+    row_.clear();
+    auto out = std::back_inserter(row_);
+
+    if (show_timestamp_) {
+        auto now = std::time(nullptr);
+
+        if (now - last_timestamp_ >= show_timestamp_every_n_seconds_) {
+            last_timestamp_ = now;
+            std::tm* cur_time = std::gmtime(&now);
+            fmt::format_to(
+                out,
+                "\033[0;0m[{:02}:{:02}:{:02}]    ",
+                cur_time->tm_hour,
+                cur_time->tm_min,
+                cur_time->tm_sec
+            );
         }
-
-        if (show_timestamp_) {
-            auto now = std::time(nullptr);
-
-            if (now - last_timestamp_ >= show_timestamp_every_n_seconds_) {
-                last_timestamp_ = now;
-                std::tm* cur_time = std::gmtime(&now);
-                std::cout << fmt::format(
-                    "\033[0;0m[{:02}:{:02}:{:02}]    ",
-                    cur_time->tm_hour,
-                    cur_time->tm_min,
-                    cur_time->tm_sec
-                );
-            }
-            else {
-                std::cout << "              ";
-            }
+        else {
+            row_.append("              ");
         }
+    }
 
-        std::cout << sb.str();
+    if (fft_length_ >= PARALLEL_LENGTH && pool_.threads() > 1) {
+        // Formatting dominates large rows, so each thread renders its own range of bins
+        pool_.run(fft_length_, [this] (unsigned int part, unsigned int first, unsigned int last) {
+            row_parts_[part].clear();
+            renderBins(row_parts_[part], first, last);
+        });
 
-        if (show_max_power_) {
-            float max_power = 10.f * std::log10(*max_element(std::begin(bin_power), std::end(bin_power)));
-            std::cout << fmt::format("    \033[0;0mMax: \033[0;{}m{:+0.4f}", getWeightColor(max_power - reference_level_), max_power);
+        for (auto const& part : row_parts_) {
+            row_.append(part);
         }
+    }
+    else {
+        renderBins(row_, 0, fft_length_);
+    }
 
-        if (show_total_power_) {
-            float total_power = 10.f * std::log10(std::accumulate(std::begin(bin_power), std::end(bin_power), 0.f));
-            std::cout << fmt::format("    \033[0;0mTotal: \033[0;{}m{:+0.4f}", getWeightColor(total_power - reference_level_), total_power);
-        }
+    if (show_max_power_) {
+        float max_power = 10.f * std::log10(*::max_element(std::begin(bin_power_), std::end(bin_power_)));
+        fmt::format_to(out, "    \033[0;0mMax: \033[0;{}m{:+0.4f}", getWeightColor(max_power - reference_level_), max_power);
+    }
 
-        std::cout << std::endl;
+    if (show_total_power_) {
+        float total_power = 10.f * std::log10(std::accumulate(std::begin(bin_power_), std::end(bin_power_), 0.f));
+        fmt::format_to(out, "    \033[0;0mTotal: \033[0;{}m{:+0.4f}", getWeightColor(total_power - reference_level_), total_power);
     }
+
+    std::cout << row_ << std::endl;
 }
 
 void Waterfall::onSamples(std::vector<float> const& samples)
 {
-    calculateFFT(samples);
-    displayFFT();
+    input_length_ = samples.size();
+
+    if (zoom_pending_) {
+        applyZoom();
+    }
+
+    if (zoom_.decimation_ > 1) {
+        zoomSamples(samples);
+        calculateFFT(zoom_.output_);
+    }
+    else {
+        calculateFFT(samples);
+    }
 }
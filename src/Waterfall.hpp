@@ -8,28 +8,67 @@
 #define JDRADIO_WATERFALL_HPP
 
 #include "FFT.hpp"
+#include "WorkerPool.hpp"
 #include <string>
 #include <vector>
 #include <array>
 #include <ctime>
+#include <functional>
+#include <mutex>
+#include <atomic>
 
 class Waterfall
 {
 public:
+    //! Bounds the zoom filter to 3585 taps
+    static constexpr unsigned int MAX_ZOOM_DECIMATION = 256;
+
     Waterfall(void) noexcept;
 
     void onSamples(std::vector<float> const& samples);
     void setFFTLength(unsigned int len);
+    unsigned int fftLength(void) const noexcept;
     void setAverageLength(unsigned int len);
     void setReferenceLevel(float ref);
     void setScale(float scale);
+    void setWindow(FFT::Window window, float overlap);
+    void setTextOutput(bool on);
+    void setSpectrumHandler(std::function<void(std::vector<float> const&)> handler);
+    void setSampleRate(unsigned int rate);
+    //! Returns false when the span needs more decimation than MAX_ZOOM_DECIMATION
+    bool setZoom(float offset, float span);
+    //! Threads sharing the averaging and rendering of large FFTs
+    void setThreads(unsigned int threads);
+    float centerOffset(void) const noexcept;
+    float span(void) const noexcept;
 
 private:
+    //! Mixer and decimating filter in front of the FFT, built by setZoom()
+    struct Zoom
+    {
+        unsigned int decimation_;
+        float offset_;
+        float span_;
+        float step_re_;
+        float step_im_;
+        float phasor_re_;
+        float phasor_im_;
+        unsigned int phase_;
+        unsigned int head_;
+        std::vector<float> taps_;
+        std::vector<float> history_;
+        std::vector<float> output_;
+    };
+
+    void applyZoom(void);
+    void zoomSamples(std::vector<float> const& samples);
     unsigned int mapPowerLevel(float lvl, float in_min, float in_max, unsigned int out_min, unsigned int out_max);
     char getWeightCharacter(float val);
     int getWeightColor(float val);
-    std::string getWeightColorString(float val);
-    void pushToAverage(unsigned int index, float val);
+    void appendWeightColorString(std::string& out, float val);
+    void reserveRow(void);
+    void accumulateBins(float const* frames, unsigned int count, unsigned int average, bool complete, unsigned int first, unsigned int last);
+    void renderBins(std::string& out, unsigned int first, unsigned int last);
     std::vector<float> convertSamples(std::vector<std::uint8_t> const& in, bool block_dc);
     void calculateFFT(std::vector<float> const& samples);
     void displayFFT(void);
@@ -39,7 +78,12 @@ private:
     unsigned int fft_length_;
     unsigned int average_length_;
     unsigned int fft_count_;
-    std::vector<std::vector<float>> averages_;
+    std::vector<float> spectrum_;
+    std::vector<float> sums_;
+    std::vector<float> bin_power_;
+    std::string row_;
+    std::vector<std::string> row_parts_;
+    WorkerPool pool_;
     float reference_level_;
     float scale_;
     bool show_timestamp_;
@@ -47,6 +91,14 @@ private:
     bool show_total_power_;
     unsigned int show_timestamp_every_n_seconds_;
     std::time_t last_timestamp_;
+    bool show_text_;
+    std::function<void(std::vector<float> const&)> spectrum_handler_;
+    unsigned int sample_rate_;
+    std::atomic<std::size_t> input_length_;
+    Zoom zoom_;
+    Zoom pending_zoom_;
+    std::atomic<bool> zoom_pending_;
+    std::mutex zoom_mutex_;
 };
 
 #endif
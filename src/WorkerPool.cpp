@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "WorkerPool.hpp"
+#include <algorithm>
+
+WorkerPool::WorkerPool(void) noexcept :
+    threads_{},
+    parts_{1},
+    mutex_{},
+    start_cv_{},
+    done_cv_{},
+    job_{nullptr},
+    context_{nullptr},
+    length_{0},
+    generation_{0},
+    pending_{0},
+    stop_{false}
+{
+}
+
+WorkerPool::~WorkerPool(void)
+{
+    stopThreads();
+}
+
+void WorkerPool::setThreads(unsigned int threads)
+{
+    stopThreads();
+
+    parts_ = std::max(threads, 1U);
+    stop_ = false;
+
+    for (unsigned int part = 1; part < parts_; ++part) {
+        threads_.emplace_back(&WorkerPool::work, this, part, generation_);
+    }
+}
+
+unsigned int WorkerPool::threads(void) const noexcept
+{
+    return parts_;
+}
+
+void WorkerPool::stopThreads(void)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stop_ = true;
+    }
+
+    start_cv_.notify_all();
+
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+
+    threads_.clear();
+}
+
+unsigned int WorkerPool::partStart(unsigned int part) const noexcept
+{
+    return static_cast<std::uint64_t>(length_) * part / parts_;
+}
+
+void WorkerPool::dispatch(unsigned int length, Job job, void const* context)
+{
+    if (parts_ == 1) {
+        job(context, 0, 0, length);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        job_ = job;
+        context_ = context;
+        length_ = length;
+        pending_ = parts_ - 1;
+        ++generation_;
+    }
+
+    start_cv_.notify_all();
+
+    job(context, 0, 0, partStart(1));
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void WorkerPool::work(unsigned int part, std::uint64_t generation)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+
+    for (;;) {
+        // The generation tells a new job from a spurious wakeup
+        start_cv_.wait(lock, [&] { return stop_ || generation_ != generation; });
+
+        if (stop_) {
+            return;
+        }
+
+        generation = generation_;
+        Job const job = job_;
+        void const* context = context_;
+        unsigned int const first = partStart(part);
+        unsigned int const last = partStart(part + 1);
+
+        lock.unlock();
+        job(context, part, first, last);
+        lock.lock();
+
+        if (--pending_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#ifndef JDRADIO_WORKERPOOL_HPP
+#define JDRADIO_WORKERPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//! Fixed set of threads sharing one data-parallel job at a time.
+//!
+//! run() splits [0, length) in one contiguous part per thread, in order, and
+//! calls func(part, first, last) for each. The calling thread takes part 0
+//! and returns once every part is done. Nothing is allocated per job, so it
+//! can be used on the sample thread after warm-up.
+class WorkerPool
+{
+public:
+    WorkerPool(void) noexcept;
+    ~WorkerPool(void);
+
+    //! Total number of parts, the calling thread included
+    void setThreads(unsigned int threads);
+    unsigned int threads(void) const noexcept;
+
+    template<class F>
+    void run(unsigned int length, F const& func)
+    {
+        dispatch(length, [] (void const* context, unsigned int part, unsigned int first, unsigned int last) {
+            (*static_cast<F const*>(context))(part, first, last);
+        }, &func);
+    }
+
+private:
+    using Job = void (*)(void const* context, unsigned int part, unsigned int first, unsigned int last);
+
+    void dispatch(unsigned int length, Job job, void const* context);
+    void work(unsigned int part, std::uint64_t generation);
+    void stopThreads(void);
+    unsigned int partStart(unsigned int part) const noexcept;
+
+    std::vector<std::thread> threads_;
+    unsigned int parts_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    Job job_;
+    void const* context_;
+    unsigned int length_;
+    std::uint64_t generation_;
+    unsigned int pending_;
+    bool stop_;
+};
+
+#endif
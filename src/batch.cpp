@@ -0,0 +1,342 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "FFT.hpp"
+#include "ClickDetector.hpp"
+#include "NoiseBlanker.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <fmt/format.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+//! Same transfer size as a live capture, so detection sees the same buffers
+static constexpr std::size_t CHUNK_LENGTH = 16 * 32 * 512;
+
+struct Event
+{
+    double time_s_;
+    float duration_ms_;
+    bool activation_;
+};
+
+struct FileResult
+{
+    std::string path_;
+    bool ok_;
+    unsigned int sample_rate_;
+    std::uint64_t samples_;
+    unsigned int clicks_;
+    unsigned int activations_;
+    std::uint64_t blanked_samples_;
+    std::vector<Event> events_;
+};
+
+static bool hasSuffix(std::string const& str, std::string const& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void collectFiles(std::string const& path, std::vector<std::string>& out)
+{
+    struct stat st{};
+
+    if (::stat(path.c_str(), &st) < 0) {
+        std::cerr << fmt::format("Cannot access {}", path) << std::endl;
+        return;
+    }
+
+    if (! S_ISDIR(st.st_mode)) {
+        out.push_back(path);
+        return;
+    }
+
+    DIR* dir = ::opendir(path.c_str());
+
+    if (! dir) {
+        return;
+    }
+
+    while (auto* entry = ::readdir(dir)) {
+        std::string const name = entry->d_name;
+
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        auto const full = path + "/" + name;
+
+        if (hasSuffix(name, ".cu8") || hasSuffix(name, ".sigmf-data")) {
+            out.push_back(full);
+        }
+        else if (::stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            collectFiles(full, out);
+        }
+    }
+
+    ::closedir(dir);
+}
+
+//! Recordings made by ARCAL carry their sample rate in the SigMF metadata
+static unsigned int recordingSampleRate(std::string const& path, unsigned int fallback)
+{
+    if (! hasSuffix(path, ".sigmf-data")) {
+        return fallback;
+    }
+
+    std::ifstream meta{path.substr(0, path.size() - 4) + "meta"};
+    std::stringstream contents;
+    contents << meta.rdbuf();
+
+    auto const text = contents.str();
+    auto const key = text.find("\"core:sample_rate\"");
+
+    if (key == std::string::npos) {
+        return fallback;
+    }
+
+    auto const colon = text.find(':', key + 18);
+    auto const rate = colon == std::string::npos ? 0 : std::strtoul(text.c_str() + colon + 1, nullptr, 10);
+
+    // A rate of 0 would make the detector divide by zero
+    return rate > 0 ? rate : fallback;
+}
+
+static FileResult analyzeFile(std::string const& path, unsigned int default_rate, ClickDetector::Framing framing)
+{
+    FileResult result{path, false, recordingSampleRate(path, default_rate), 0, 0, 0, 0, {}};
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+
+    if (! file) {
+        return result;
+    }
+
+    // Same frames as the live detector, so the counts match for the same --detector choice
+    FFT fft{};
+    ClickDetector::setupFFT(fft, framing);
+
+    NoiseBlanker blanker{};
+    ClickDetector detector{};
+    detector.configure(result.sample_rate_, fft);
+
+    float const frames_per_ms = detector.framesPerMs();
+    std::deque<double> window;
+
+    detector.setHandler([&] (auto const& transmission) {
+        if (! transmission.click_) {
+            return;
+        }
+
+        double const start = transmission.start_frame_ / frames_per_ms / 1000.0;
+        double const end = start + transmission.duration_ms_ / 1000.0;
+        result.events_.push_back(Event{start, transmission.duration_ms_, false});
+        ++result.clicks_;
+
+        // Five clicks within five seconds, as in ARCAL::verifyClicks, timed by samples
+        while (! window.empty() && end - window.front() > 5.0) {
+            window.pop_front();
+        }
+
+        window.push_back(end);
+
+        if (window.size() >= 5) {
+            window.clear();
+            result.events_.push_back(Event{end, 0.f, true});
+            ++result.activations_;
+        }
+    });
+
+    std::vector<std::uint8_t> raw(CHUNK_LENGTH);
+    std::vector<float> samples(CHUNK_LENGTH);
+    std::vector<float> bins;
+    bool have_offset = false;
+    float offset = 127.5f;
+
+    for (;;) {
+        std::size_t const count = std::fread(raw.data(), 1, raw.size(), file) & ~static_cast<std::size_t>(1);
+
+        if (count == 0) {
+            break;
+        }
+
+        if (! have_offset) {
+            float sum = 0.f;
+            for (std::size_t n = 0; n < count; ++n) {
+                sum += static_cast<float>(raw[n]) - 127.5f;
+            }
+            offset += sum / count;
+            have_offset = true;
+        }
+
+        samples.resize(count);
+        for (std::size_t n = 0; n < count; ++n) {
+            samples[n] = (static_cast<float>(raw[n]) - offset) * (1.f / 128.f);
+        }
+
+        result.blanked_samples_ += blanker.execute(samples);
+        fft.execute(samples, bins);
+        detector.execute(bins);
+        result.samples_ += count / 2;
+    }
+
+    result.ok_ = ! std::ferror(file);
+    std::fclose(file);
+
+    return result;
+}
+
+static bool writeReport(FileResult const& result, std::string const& out_dir)
+{
+    auto const slash = result.path_.find_last_of('/');
+    auto const name = slash == std::string::npos ? result.path_ : result.path_.substr(slash + 1);
+    auto const report_path = (out_dir.empty() ? result.path_ : out_dir + "/" + name) + ".clicks.csv";
+
+    std::ofstream out{report_path, std::ios::trunc};
+
+    if (! out) {
+        return false;
+    }
+
+    out << fmt::format("# {}\n", result.path_);
+    out << fmt::format("# sample_rate {}, duration {:.1f} s, clicks {}, activations {}, blanked_samples {}\n", result.sample_rate_, static_cast<double>(result.samples_) / result.sample_rate_, result.clicks_, result.activations_, result.blanked_samples_);
+    out << "event,time_s,duration_ms\n";
+
+    for (auto const& event : result.events_) {
+        out << fmt::format("{},{:.3f},{:.1f}\n", event.activation_ ? "activation" : "click", event.time_s_, event.duration_ms_);
+    }
+
+    return static_cast<bool>(out);
+}
+
+//! Usage: arcal-batch [-j threads] [-r sample_rate] [-o report_dir] [-d rect|hann] <file|directory>...
+//!
+//! Runs click detection over cu8 recordings (.cu8 or .sigmf-data), one file per
+//! worker thread, and writes a .clicks.csv report for each file. -d picks the
+//! detector frames like arcal's --detector, rectangular by default.
+int main(int argc, char** argv)
+{
+    unsigned int threads = std::max(1U, std::thread::hardware_concurrency());
+    unsigned int sample_rate = 256'000U;
+    std::string out_dir;
+    ClickDetector::Framing framing = ClickDetector::Framing::Rectangular;
+    std::vector<std::string> files;
+
+    for (int n = 1; n < argc; ++n) {
+        if (std::strcmp(argv[n], "-j") == 0 && n + 1 < argc) {
+            threads = std::max(1UL, std::strtoul(argv[++n], nullptr, 10));
+        }
+        else if (std::strcmp(argv[n], "-r") == 0 && n + 1 < argc && std::strtoul(argv[n + 1], nullptr, 10) > 0) {
+            sample_rate = std::strtoul(argv[++n], nullptr, 10);
+        }
+        else if (std::strcmp(argv[n], "-o") == 0 && n + 1 < argc) {
+            out_dir = argv[++n];
+        }
+        else if (std::strcmp(argv[n], "-d") == 0 && n + 1 < argc && std::strcmp(argv[n + 1], "rect") == 0) {
+            framing = ClickDetector::Framing::Rectangular;
+            ++n;
+        }
+        else if (std::strcmp(argv[n], "-d") == 0 && n + 1 < argc && std::strcmp(argv[n + 1], "hann") == 0) {
+            framing = ClickDetector::Framing::HannOverlapped;
+            ++n;
+        }
+        else if (argv[n][0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [-j threads] [-r sample_rate] [-o report_dir] [-d rect|hann] <file|directory>..." << std::endl;
+            return 1;
+        }
+        else {
+            collectFiles(argv[n], files);
+        }
+    }
+
+    if (files.empty()) {
+        std::cerr << "No recordings to analyze" << std::endl;
+        return 1;
+    }
+
+    // Largest first, so a long recording does not start last and hold up the end of the run
+    std::vector<std::pair<off_t, std::string>> sized;
+    for (auto const& file : files) {
+        struct stat st{};
+        ::stat(file.c_str(), &st);
+        sized.emplace_back(st.st_size, file);
+    }
+    std::sort(std::begin(sized), std::end(sized), [] (auto const& a, auto const& b) { return a.first > b.first; });
+
+    threads = std::min<unsigned int>(threads, sized.size());
+
+    std::atomic<std::size_t> next{0};
+    std::mutex print_mutex;
+    std::uint64_t total_samples = 0;
+    double total_seconds = 0.0;
+    unsigned int total_clicks = 0;
+    unsigned int total_activations = 0;
+    unsigned int failures = 0;
+    std::vector<std::thread> workers;
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (;;) {
+                std::size_t const index = next++;
+
+                if (index >= sized.size()) {
+                    break;
+                }
+
+                auto const result = analyzeFile(sized[index].second, sample_rate, framing);
+                bool const written = result.ok_ && writeReport(result, out_dir);
+
+                std::lock_guard<std::mutex> lock{print_mutex};
+
+                if (! written) {
+                    ++failures;
+                    std::cerr << fmt::format("Failed to analyze {}", result.path_) << std::endl;
+                    continue;
+                }
+
+                total_samples += result.samples_;
+                total_seconds += static_cast<double>(result.samples_) / result.sample_rate_;
+                total_clicks += result.clicks_;
+                total_activations += result.activations_;
+
+                std::cout << fmt::format("{}: {} clicks, {} activations", result.path_, result.clicks_, result.activations_) << std::endl;
+            }
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    float const elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << fmt::format(
+        "{} files on {} threads in {:.2f} s: {} clicks, {} activations, {:.1f} Msps ({:.0f}x real time)",
+        sized.size() - failures,
+        threads,
+        elapsed,
+        total_clicks,
+        total_activations,
+        total_samples / elapsed / 1e6,
+        total_seconds / elapsed
+    ) << std::endl;
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "FFT.hpp"
+#include "FixedFFT.hpp"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <fftw3.h>
+
+//! Transforms per measurement, enough for each one to run well past the clock resolution
+static constexpr unsigned int DEFAULT_ITERATIONS = 200000;
+
+//! Keeps the compiler from dropping a transform whose output is never read
+static float volatile sink;
+
+template<typename F>
+static double timePerCall(unsigned int iterations, F&& call)
+{
+    // One untimed pass, so page faults and cold caches stay out of the measurement
+    call();
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (unsigned int n = 0; n < iterations; ++n) {
+        call();
+    }
+
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+//! The unrolled kernel, FFTW on the same buffers, and FFT::execute, which picks one of them
+template<unsigned int N>
+static void compare(unsigned int iterations)
+{
+    std::mt19937 rng{N};
+    std::uniform_real_distribution<float> dist{-1.f, 1.f};
+
+    fftwf_complex* in = fftwf_alloc_complex(N);
+    fftwf_complex* work = fftwf_alloc_complex(N);
+    fftwf_complex* out_fixed = fftwf_alloc_complex(N);
+    fftwf_complex* out_fftw = fftwf_alloc_complex(N);
+
+    for (unsigned int n = 0; n < N; ++n) {
+        in[n][0] = dist(rng);
+        in[n][1] = dist(rng);
+    }
+
+    // The same flags FFT uses by default, minus FFTW_DESTROY_INPUT since the input is reused
+    fftwf_plan plan = fftwf_plan_dft_1d(N, work, out_fftw, FFTW_FORWARD, FFTW_MEASURE);
+    std::copy(&in[0][0], &in[0][0] + N * 2, &work[0][0]);
+
+    FixedFFT<N>::execute(in, out_fixed);
+    fftwf_execute(plan);
+
+    float error = 0.f;
+
+    for (unsigned int n = 0; n < N; ++n) {
+        error = std::max(error, std::hypot(out_fixed[n][0] - out_fftw[n][0], out_fixed[n][1] - out_fftw[n][1]));
+    }
+
+    double const fixed_ns = timePerCall(iterations, [&] {
+        FixedFFT<N>::execute(in, out_fixed);
+        sink = out_fixed[1][0];
+    });
+
+    double const fftw_ns = timePerCall(iterations, [&] {
+        fftwf_execute(plan);
+        sink = out_fftw[1][0];
+    });
+
+    // Rectangular without overlap, so each frame is one transform plus the history copy
+    FFT fft;
+    fft.setLength(N);
+    fft.setWindow(FFT::Window::Rectangular);
+    fft.setOverlap(0.f);
+
+    std::vector<float> const samples(&in[0][0], &in[0][0] + N * 2);
+    std::vector<float> spectrum;
+
+    double const execute_ns = timePerCall(iterations, [&] {
+        fft.execute(samples, spectrum);
+        sink = spectrum[1];
+    });
+
+    std::cout << fmt::format(
+        "N={:<4} FixedFFT {:8.1f} ns   FFTW {:8.1f} ns   FFT::execute {:8.1f} ns   max error {:.1e}",
+        N,
+        fixed_ns,
+        fftw_ns,
+        execute_ns,
+        error
+    ) << std::endl;
+
+    fftwf_destroy_plan(plan);
+    fftwf_free(in);
+    fftwf_free(work);
+    fftwf_free(out_fixed);
+    fftwf_free(out_fftw);
+}
+
+static void usage(char const* name)
+{
+    std::cerr << fmt::format("Usage: {} [iterations]", name) << std::endl;
+    std::cerr << "  Times the unrolled FFT kernels against FFTW and FFT::execute, per transform" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int iterations = DEFAULT_ITERATIONS;
+
+    if (argc > 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        char* end = nullptr;
+        long const value = std::strtol(argv[1], &end, 10);
+
+        if (end == argv[1] || *end != '\0' || value <= 0) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        iterations = static_cast<unsigned int>(value);
+    }
+
+    // 32 is handled by the kernels, 256 is where FFT switches back to FFTW
+    compare<32>(iterations);
+    compare<256>(iterations);
+
+    return 0;
+}
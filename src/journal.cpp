@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Jean-Sebastien Dominique <jd@jdradio.dev>
+//! \date 2021
+//! \copyright JDRadio Inc.
+////////////////////////////////////////////////////////////////////////////////
+#include "EventJournal.hpp"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//! Accepts UNIX seconds or a UTC date and time such as 2021-06-01T14:30:00
+static bool parseTime(char const* text, std::uint64_t& ns)
+{
+    std::tm t{};
+    char const* end = strptime(text, "%Y-%m-%dT%H:%M:%S", &t);
+
+    if (! end) {
+        end = strptime(text, "%Y-%m-%d", &t);
+    }
+
+    if (end && (*end == '\0' || *end == 'Z')) {
+        ns = static_cast<std::uint64_t>(timegm(&t)) * 1'000'000'000ULL;
+        return true;
+    }
+
+    char* num_end = nullptr;
+    double const seconds = std::strtod(text, &num_end);
+
+    if (num_end == text || *num_end != '\0' || seconds < 0) {
+        return false;
+    }
+
+    ns = static_cast<std::uint64_t>(seconds * 1e9);
+    return true;
+}
+
+static bool parseTypes(char const* text, unsigned int& mask)
+{
+    mask = 0;
+    std::string const list = text;
+    std::size_t start = 0;
+
+    while (start <= list.size()) {
+        auto const comma = std::min(list.find(',', start), list.size());
+        auto const name = list.substr(start, comma - start);
+        bool found = false;
+
+        for (unsigned int type = 1; type <= 5; ++type) {
+            if (name == EventJournal::eventName(static_cast<EventJournal::Event>(type))) {
+                mask |= 1U << type;
+                found = true;
+            }
+        }
+
+        if (! found) {
+            return false;
+        }
+
+        start = comma + 1;
+    }
+
+    return true;
+}
+
+static void usage(char const* name)
+{
+    std::cerr << "Usage: " << name << " <journal> [--from time] [--to time] [--type signal_on,signal_off,click,activation,drop] [--count]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::uint64_t from = 0;
+    std::uint64_t to = std::numeric_limits<std::uint64_t>::max();
+    unsigned int mask = ~0U;
+    bool count_only = false;
+
+    for (int n = 2; n < argc; ++n) {
+        bool ok = true;
+
+        if (std::strcmp(argv[n], "--from") == 0 && n + 1 < argc) {
+            ok = parseTime(argv[++n], from);
+        }
+        else if (std::strcmp(argv[n], "--to") == 0 && n + 1 < argc) {
+            ok = parseTime(argv[++n], to);
+        }
+        else if (std::strcmp(argv[n], "--type") == 0 && n + 1 < argc) {
+            ok = parseTypes(argv[++n], mask);
+        }
+        else if (std::strcmp(argv[n], "--count") == 0) {
+            count_only = true;
+        }
+        else {
+            ok = false;
+        }
+
+        if (! ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int fd = ::open(argv[1], O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+
+    if (fd < 0 || ::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < EventJournal::HEADER_SIZE) {
+        std::cerr << fmt::format("Cannot read journal {}", argv[1]) << std::endl;
+        return 1;
+    }
+
+    void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+        std::cerr << fmt::format("Cannot map journal {}: {}", argv[1], std::strerror(errno)) << std::endl;
+        return 1;
+    }
+
+    auto const* base = static_cast<std::uint8_t const*>(map);
+    std::uint32_t magic = 0;
+    std::uint16_t version = 0;
+    std::uint16_t record_size = 0;
+    std::memcpy(&magic, base, 4);
+    std::memcpy(&version, base + 4, 2);
+    std::memcpy(&record_size, base + 6, 2);
+
+    if (magic != EventJournal::MAGIC || record_size != sizeof(EventJournal::Record)) {
+        std::cerr << fmt::format("{} is not an ARCAL journal", argv[1]) << std::endl;
+        return 1;
+    }
+
+    if (version != EventJournal::VERSION) {
+        std::cerr << fmt::format("{} is a version {} journal, only version {} is supported", argv[1], version, EventJournal::VERSION) << std::endl;
+        return 1;
+    }
+
+    // The writer may be appending; a partial last record is ignored
+    std::size_t const total = (st.st_size - EventJournal::HEADER_SIZE) / sizeof(EventJournal::Record);
+    auto const* records = reinterpret_cast<EventJournal::Record const*>(base + EventJournal::HEADER_SIZE);
+    ::madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    auto const start = std::chrono::steady_clock::now();
+    std::uint64_t matches = 0;
+    fmt::memory_buffer out;
+
+    for (std::size_t n = 0; n < total; ++n) {
+        auto const& record = records[n];
+
+        // A corrupt type would also shift past the mask
+        if (record.type_ < static_cast<std::uint16_t>(EventJournal::Event::SignalOn) || record.type_ > static_cast<std::uint16_t>(EventJournal::Event::Drop)) {
+            continue;
+        }
+
+        if (record.time_ < from || record.time_ >= to || ! (mask & (1U << record.type_))) {
+            continue;
+        }
+
+        ++matches;
+
+        if (count_only) {
+            continue;
+        }
+
+        std::time_t const secs = record.time_ / 1'000'000'000ULL;
+        std::tm t{};
+        gmtime_r(&secs, &t);
+
+        fmt::format_to(
+            std::back_inserter(out),
+            "{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:06}Z {:<10} {:.3f} MHz",
+            t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+            (record.time_ % 1'000'000'000ULL) / 1000,
+            EventJournal::eventName(static_cast<EventJournal::Event>(record.type_)),
+            record.frequency_ / 1e6
+        );
+
+        if (record.duration_ > 0) {
+            fmt::format_to(std::back_inserter(out), " {:.1f} ms", record.duration_ / 1e3);
+        }
+
+        if (record.value_ > 0) {
+            fmt::format_to(std::back_inserter(out), " {} samples", record.value_);
+        }
+
+        out.push_back('\n');
+
+        // Written in large chunks, printing dominates a query over many records
+        if (out.size() > (1U << 20)) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+
+    std::fwrite(out.data(), 1, out.size(), stdout);
+
+    float const elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (count_only) {
+        std::cout << matches << std::endl;
+    }
+
+    std::cerr << fmt::format("{} of {} records matched in {:.1f} ms", matches, total, elapsed) << std::endl;
+
+    ::munmap(map, st.st_size);
+
+    return 0;
+}
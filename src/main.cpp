@@ -5,9 +5,333 @@
 //! \copyright JDRadio Inc.
 ////////////////////////////////////////////////////////////////////////////////
 #include "ARCAL.hpp"
+#include <iostream>
+#include <string>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
 
-int main(int, char**)
+//! Usage: arcal [--effort estimate|measure|patient] [--threads count] [--plan [length...]]
+//!              [--realtime [core [priority]]] [--jitter] [--rtl-tcp host[:port]]
+//!              [--record [directory]]
+//!              [--stream-spectrum [socket]]
+//!              [--scan [start_hz stop_hz step_hz]]
+//!              [--log-spectrum [directory]]
+//!              [--auto-gain [recalibrate]]
+//!              [--audio fifo|wav|stdout]
+//!              [--detector rect|hann]
+//!              [--gate]
+//!
+//! --plan fills the FFTW wisdom cache for the given lengths (or the usual
+//! waterfall sizes) and exits, so later startups do not have to measure.
+//! --threads spreads large waterfall FFTs, from 8192 points, over that many
+//! threads; plan with the same count, as threaded plans have their own wisdom.
+//! --realtime locks memory and runs the sample thread on SCHED_FIFO, pinned to
+//! a core (3 by default, at priority 40). --jitter reports buffer arrival
+//! jitter in the metrics and on exit. --rtl-tcp reads samples from an rtl_tcp
+//! server (port 1234 by default) instead of the first USB dongle.
+//! --record writes the raw samples as rotating SigMF files, in the current
+//! directory unless one is given.
+//! --stream-spectrum serves binary spectrum rows on a UNIX socket, by default
+//! /tmp/arcal-spectrum.sock.
+//! --scan hops over the airband in 250 kHz steps, or over the given range, and
+//! writes channel occupancy to scan-report.csv instead of detecting clicks.
+//! --log-spectrum saves the waterfall rows as image tiles with a timestamp
+//! index, in the current directory unless one is given.
+//! --auto-gain sweeps the tuner gains for the best SNR on a reference signal
+//! that has to be on the air, and caches the result per device; "recalibrate"
+//! ignores the cached gain.
+//! --audio demodulates the channel as AM and writes the audio to the FIFO
+//! /tmp/arcal-audio.pcm, to arcal-audio.wav, or to stdout, in which case every
+//! message goes to stderr.
+//! --detector picks the click detector's frames: rectangular without overlap,
+//! which the detection level was tuned on, or Hann with half overlap for twice
+//! the time resolution, with the level raised by the window's noise bandwidth.
+//! --gate skips the detector and the text waterfall while the energy near the
+//! channel stays at the noise floor, to save CPU on a quiet frequency.
+static char const* const USAGE = " [--effort estimate|measure|patient] [--threads count] [--plan [length...]] [--realtime [core [priority]]] [--jitter] [--rtl-tcp host[:port]] [--record [directory]] [--stream-spectrum [socket]] [--scan [start_hz stop_hz step_hz]] [--log-spectrum [directory]] [--auto-gain [recalibrate]] [--audio fifo|wav|stdout] [--detector rect|hann] [--gate]";
+
+//! Optional numeric argument following a flag
+static bool nextNumber(int argc, char** argv, int& n, int& value)
+{
+    if (n + 1 >= argc) {
+        return false;
+    }
+
+    char* end = nullptr;
+    long const number = std::strtol(argv[n + 1], &end, 10);
+
+    if (end == argv[n + 1] || *end != '\0' || number < 0 || number > std::numeric_limits<int>::max()) {
+        return false;
+    }
+
+    value = static_cast<int>(number);
+    ++n;
+    return true;
+}
+
+//! "host", "host:port" or "[v6 address]:port"
+static bool parseHostPort(std::string const& text, std::string& host, unsigned short& port)
+{
+    auto const colon = text.rfind(':');
+    bool const bracketed = ! text.empty() && text.front() == '[';
+
+    // A bare IPv6 address has colons of its own and no port
+    if (colon == std::string::npos || (! bracketed && text.find(':') != colon)) {
+        host = text;
+        return ! host.empty();
+    }
+
+    if (bracketed && text.back() == ']') {
+        host = text.substr(1, text.size() - 2);
+        return ! host.empty();
+    }
+
+    char* end = nullptr;
+    unsigned long const number = std::strtoul(text.c_str() + colon + 1, &end, 10);
+
+    if (*end != '\0' || end == text.c_str() + colon + 1 || number == 0 || number > 65535) {
+        return false;
+    }
+
+    host = bracketed ? text.substr(1, colon - 2) : text.substr(0, colon);
+    port = static_cast<unsigned short>(number);
+    return ! host.empty() && (! bracketed || text[colon - 1] == ']');
+}
+
+//! Optional argument following a flag, anything but another flag
+static bool nextValue(int argc, char** argv, int& n, std::string& value)
+{
+    if (n + 1 >= argc || argv[n + 1][0] == '-') {
+        return false;
+    }
+
+    value = argv[++n];
+    return true;
+}
+
+int main(int argc, char** argv)
 {
-    ARCAL{}.run();
+    auto const wisdom = FFT::defaultWisdomPath();
+    bool plan = false;
+    std::vector<unsigned int> lengths;
+    bool realtime = false;
+    int core = -1;
+    int priority = -1;
+    bool jitter = false;
+    std::string rtl_tcp_host;
+    unsigned short rtl_tcp_port = 1234;
+    bool record = false;
+    std::string record_directory = ".";
+    bool stream_spectrum = false;
+    std::string spectrum_socket = "/tmp/arcal-spectrum.sock";
+    bool scan = false;
+    int scan_start = 0;
+    int scan_stop = 0;
+    int scan_step = 0;
+    bool log_spectrum = false;
+    std::string spectrum_directory = ".";
+    bool auto_gain = false;
+    bool recalibrate_gain = false;
+    bool audio = false;
+    AudioSink::Output audio_output = AudioSink::Output::Fifo;
+    ClickDetector::Framing framing = ClickDetector::Framing::Rectangular;
+    bool gate = false;
+
+    for (int n = 1; n < argc; ++n) {
+        if (std::strcmp(argv[n], "--effort") == 0 && n + 1 < argc) {
+            ++n;
+            if (std::strcmp(argv[n], "estimate") == 0) {
+                FFT::setPlannerEffort(FFT::Effort::Estimate);
+            }
+            else if (std::strcmp(argv[n], "patient") == 0) {
+                FFT::setPlannerEffort(FFT::Effort::Patient);
+            }
+            else if (std::strcmp(argv[n], "measure") == 0) {
+                FFT::setPlannerEffort(FFT::Effort::Measure);
+            }
+            else {
+                std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[n], "--threads") == 0) {
+            int threads = 0;
+
+            if (! nextNumber(argc, argv, n, threads) || threads == 0) {
+                std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                return 1;
+            }
+
+            FFT::setThreads(static_cast<unsigned int>(threads));
+        }
+        else if (std::strcmp(argv[n], "--plan") == 0) {
+            int length = 0;
+            plan = true;
+
+            // Lengths follow the flag, and anything not a number ends them
+            while (nextNumber(argc, argv, n, length)) {
+                if (length == 0) {
+                    std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                    return 1;
+                }
+
+                lengths.push_back(static_cast<unsigned int>(length));
+            }
+        }
+        else if (std::strcmp(argv[n], "--realtime") == 0) {
+            realtime = true;
+
+            if (nextNumber(argc, argv, n, core)) {
+                nextNumber(argc, argv, n, priority);
+            }
+        }
+        else if (std::strcmp(argv[n], "--jitter") == 0) {
+            jitter = true;
+        }
+        else if (std::strcmp(argv[n], "--rtl-tcp") == 0 && n + 1 < argc) {
+            if (! parseHostPort(argv[++n], rtl_tcp_host, rtl_tcp_port)) {
+                std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[n], "--record") == 0) {
+            record = true;
+            nextValue(argc, argv, n, record_directory);
+        }
+        else if (std::strcmp(argv[n], "--stream-spectrum") == 0) {
+            stream_spectrum = true;
+            nextValue(argc, argv, n, spectrum_socket);
+        }
+        else if (std::strcmp(argv[n], "--scan") == 0) {
+            scan = true;
+
+            // The range is all three or nothing
+            if (nextNumber(argc, argv, n, scan_start)) {
+                if (! nextNumber(argc, argv, n, scan_stop) || ! nextNumber(argc, argv, n, scan_step) || scan_step == 0 || scan_stop < scan_start) {
+                    std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                    return 1;
+                }
+            }
+        }
+        else if (std::strcmp(argv[n], "--log-spectrum") == 0) {
+            log_spectrum = true;
+            nextValue(argc, argv, n, spectrum_directory);
+        }
+        else if (std::strcmp(argv[n], "--auto-gain") == 0) {
+            auto_gain = true;
+
+            if (n + 1 < argc && std::strcmp(argv[n + 1], "recalibrate") == 0) {
+                recalibrate_gain = true;
+                ++n;
+            }
+        }
+        else if (std::strcmp(argv[n], "--audio") == 0 && n + 1 < argc) {
+            audio = true;
+            ++n;
+
+            if (std::strcmp(argv[n], "fifo") == 0) {
+                audio_output = AudioSink::Output::Fifo;
+            }
+            else if (std::strcmp(argv[n], "wav") == 0) {
+                audio_output = AudioSink::Output::Wav;
+            }
+            else if (std::strcmp(argv[n], "stdout") == 0) {
+                audio_output = AudioSink::Output::Stdout;
+            }
+            else {
+                std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[n], "--detector") == 0 && n + 1 < argc) {
+            ++n;
+
+            if (std::strcmp(argv[n], "rect") == 0) {
+                framing = ClickDetector::Framing::Rectangular;
+            }
+            else if (std::strcmp(argv[n], "hann") == 0) {
+                framing = ClickDetector::Framing::HannOverlapped;
+            }
+            else {
+                std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[n], "--gate") == 0) {
+            gate = true;
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << USAGE << std::endl;
+            return 1;
+        }
+    }
+
+    FFT::importWisdom(wisdom);
+
+    if (plan) {
+        if (lengths.empty()) {
+            lengths = {128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536};
+        }
+
+        FFT::prePlan(lengths);
+
+        if (! FFT::exportWisdom(wisdom)) {
+            std::cerr << "Failed to write " << wisdom << std::endl;
+            return 1;
+        }
+
+        std::cout << "Wisdom saved to " << wisdom << std::endl;
+        return 0;
+    }
+
+    // Before ARCAL starts any thread, since threads inherit the mask they are created with;
+    // otherwise a worker could take SIGINT and kill the process without a clean shutdown
+    EventLoop::blockSignals({SIGINT, SIGTERM});
+
+    ARCAL arcal;
+
+    if (realtime) {
+        arcal.setRealtime(core, priority);
+    }
+
+    arcal.setJitterMeasurement(jitter);
+
+    if (! rtl_tcp_host.empty()) {
+        arcal.setRtlTcp(rtl_tcp_host, rtl_tcp_port);
+    }
+
+    if (record) {
+        arcal.setRecording(record_directory);
+    }
+
+    if (stream_spectrum) {
+        arcal.setSpectrumStream(spectrum_socket);
+    }
+
+    if (scan) {
+        arcal.setScan(scan_start, scan_stop, scan_step);
+    }
+
+    if (log_spectrum) {
+        arcal.setSpectrumLogging(spectrum_directory);
+    }
+
+    if (auto_gain) {
+        arcal.setAutoGain(recalibrate_gain);
+    }
+
+    if (audio) {
+        arcal.setAudioOutput(audio_output);
+    }
+
+    arcal.setDetectorFraming(framing);
+    arcal.setEnergyGate(gate);
+    arcal.run();
+
+    // Keeps whatever was planned during this run for the next startup
+    FFT::exportWisdom(wisdom);
+
     return 0;
 }